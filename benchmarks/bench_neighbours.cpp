@@ -0,0 +1,73 @@
+/***************************************************************************
+
+  Copyright 2016-2020 Tom Furnival
+
+  This file is part of ctrwfractal.
+
+  ctrwfractal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ctrwfractal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ctrwfractal.  If not, see <http://www.gnu.org/licenses/>.
+
+  Benchmark of CTRWfractal::FindNeighbours against grid size for the
+  square and honeycomb lattices. Build from the repository root with:
+
+    g++ -O3 -std=c++11 -march=native -pthread -I ctrwfractal \
+        benchmarks/bench_neighbours.cpp -o bench_neighbours -larmadillo
+
+  Usage: ./bench_neighbours [maxGridSize=4096] [nJobs=-1] [nRepeats=3]
+
+***************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "_ctrw.hpp"
+
+int main(int argc, char **argv)
+{
+  const uint64_t maxGridSize = (argc > 1) ? std::atoll(argv[1]) : 4096;
+  const int64_t nJobs = (argc > 2) ? std::atoll(argv[2]) : -1;
+  const uint64_t nRepeats = (argc > 3) ? std::atoll(argv[3]) : 3;
+
+  const char *latticeNames[2] = {"square", "honeycomb"};
+  std::ostringstream sink;
+
+  PrintFixed(0, "lattice\tgridSize\tnSites\tseconds\n");
+
+  for (uint64_t latticeType = 0; latticeType < 2; latticeType++)
+  {
+    for (uint64_t gridSize = 256; gridSize <= maxGridSize; gridSize *= 2)
+    {
+      double best = 0.0;
+      for (size_t r = 0; r < nRepeats; r++)
+      {
+        CTRWfractal<double> sim(gridSize, latticeType, 0.5, 0, 0, 0, 0.0, 1.0, 0.0, 1, nJobs, 0, 0, 0);
+
+        std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf()); // Silence stage timings
+        auto t0 = GetTime();
+        sim.FindNeighbours();
+        auto t1 = GetTime();
+        std::cout.rdbuf(coutBuf);
+
+        double elapsed = ElapsedSeconds(t0, t1);
+        best = (r == 0) ? elapsed : std::min(best, elapsed);
+      }
+
+      uint64_t nSites = (latticeType == 1) ? 4 * gridSize * gridSize : gridSize * gridSize;
+      PrintFixed(0, latticeNames[latticeType], "\t", gridSize, "\t", nSites, "\t");
+      PrintFixed(6, best, "\n");
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+/***************************************************************************
+
+  Copyright 2016-2020 Tom Furnival
+
+  This file is part of ctrwfractal.
+
+  ctrwfractal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ctrwfractal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ctrwfractal.  If not, see <http://www.gnu.org/licenses/>.
+
+  Benchmark of Percolate and RandomWalks throughput with column-major
+  and Morton site ordering, on the square lattice at its critical
+  threshold. Build from the repository root with:
+
+    g++ -O3 -std=c++11 -march=native -pthread -I ctrwfractal \
+        benchmarks/bench_ordering.cpp -o bench_ordering -larmadillo
+
+  Usage: ./bench_ordering [maxGridSize=16384] [nWalks=100] [nSteps=10000]
+
+***************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "_ctrw.hpp"
+
+int main(int argc, char **argv)
+{
+  const uint64_t maxGridSize = (argc > 1) ? std::atoll(argv[1]) : 16384;
+  const uint64_t nWalks = (argc > 2) ? std::atoll(argv[2]) : 100;
+  const uint64_t nSteps = (argc > 3) ? std::atoll(argv[3]) : 10000;
+
+  const char *orderNames[2] = {"column", "morton"};
+  std::ostringstream sink;
+
+  PrintFixed(0, "order\tgridSize\tpercolateSitesPerSecond\twalkStepsPerSecond\n");
+
+  for (uint64_t gridSize = 256; gridSize <= maxGridSize; gridSize *= 2)
+  {
+    for (uint64_t siteOrder = 0; siteOrder < 2; siteOrder++)
+    {
+      CTRWfractal<double, int32_t> sim(gridSize, 0, 0.592746, 0,
+                                       nWalks, nSteps, 0.0, 1.0, 0.0, 1, 0, siteOrder, 0, 0);
+
+      std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf()); // Silence stage timings
+      sim.FindNeighbours();
+      sim.Permute();
+
+      auto t0 = GetTime();
+      sim.Percolate();
+      auto t1 = GetTime();
+
+      sim.BuildLattice();
+      sim.GroupClusters();
+      sim.RelabelClusters();
+      sim.BuildClusterIndex();
+      sim.BuildOccupancy();
+
+      auto t2 = GetTime();
+      sim.RandomWalks();
+      auto t3 = GetTime();
+      std::cout.rdbuf(coutBuf);
+
+      double nSites = static_cast<double>(gridSize * gridSize);
+      PrintFixed(0, orderNames[siteOrder], "\t", gridSize, "\t",
+                 nSites / ElapsedSeconds(t0, t1), "\t",
+                 static_cast<double>(nWalks * nSteps) / ElapsedSeconds(t2, t3), "\n");
+      sink.str("");
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+/***************************************************************************
+
+  Copyright 2016-2020 Tom Furnival
+
+  This file is part of ctrwfractal.
+
+  ctrwfractal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ctrwfractal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ctrwfractal.  If not, see <http://www.gnu.org/licenses/>.
+
+  Benchmark of the parallel shuffle in Permute against the previous
+  single-threaded Fisher-Yates loop, on the square lattice over a range
+  of grid sizes and thread counts. The threshold is 1 so that Permute
+  shuffles every site, as the previous loop did. Build from the
+  repository root with:
+
+    g++ -O3 -std=c++11 -march=native -pthread -I ctrwfractal \
+        benchmarks/bench_permute.cpp -o bench_permute -larmadillo
+
+  Usage: ./bench_permute [maxGridSize=16384] [nRepeats=3]
+
+***************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "_ctrw.hpp"
+
+void SequentialPermute(arma::Col<int32_t> &occupation, const uint64_t N, pcg64 &RNG)
+{
+  // The single-threaded loop previously used by Permute
+  const uint32_t maxSites = 4294967294;
+  const double permConstant = 2.3283064e-10;
+  std::uniform_int_distribution<uint32_t> UniformDistribution{0, maxSites};
+  int32_t j, t_;
+
+  occupation = arma::regspace<arma::Col<int32_t>>(0, N - 1);
+
+  for (size_t i = 0; i < N; i++)
+  {
+    j = i + (N - i) * permConstant * UniformDistribution(RNG);
+    t_ = occupation(i);
+    occupation(i) = occupation(j);
+    occupation(j) = t_;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const uint64_t maxGridSize = (argc > 1) ? std::atoll(argv[1]) : 16384;
+  const uint64_t nRepeats = (argc > 2) ? std::atoll(argv[2]) : 3;
+
+  const int64_t maxJobs = std::max(1U, std::thread::hardware_concurrency());
+  std::ostringstream sink;
+
+  PrintFixed(0, "method\tnJobs\tgridSize\tseconds\tsitesPerSecond\n");
+
+  for (uint64_t gridSize = 1024; gridSize <= maxGridSize; gridSize *= 2)
+  {
+    const uint64_t N = gridSize * gridSize;
+    double elapsed = 1e300; // Best of nRepeats
+
+    for (uint64_t r = 0; r < nRepeats; r++)
+    {
+      arma::Col<int32_t> occupation;
+      pcg64 RNG(1 + r);
+
+      auto t0 = GetTime();
+      SequentialPermute(occupation, N, RNG);
+      auto t1 = GetTime();
+
+      elapsed = std::min(elapsed, ElapsedSeconds(t0, t1));
+    }
+
+    PrintFixed(0, "sequential\t1\t", gridSize, "\t");
+    PrintFixed(6, elapsed, "\t");
+    PrintFixed(0, static_cast<double>(N) / elapsed, "\n");
+
+    for (int64_t nJobs = 1; nJobs <= maxJobs; nJobs *= 2)
+    {
+      elapsed = 1e300;
+
+      for (uint64_t r = 0; r < nRepeats; r++)
+      {
+        CTRWfractal<double, int32_t> sim(gridSize, 0, 1.0, 0,
+                                         0, 0, 0.0, 1.0, 0.0, 1 + r, nJobs, 0, 0, 0);
+
+        std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf()); // Silence stage timings
+        sim.FindNeighbours();
+
+        auto t0 = GetTime();
+        sim.Permute();
+        auto t1 = GetTime();
+        std::cout.rdbuf(coutBuf);
+
+        elapsed = std::min(elapsed, ElapsedSeconds(t0, t1));
+        sink.str("");
+      }
+
+      PrintFixed(0, "parallel\t", nJobs, "\t", gridSize, "\t");
+      PrintFixed(6, elapsed, "\t");
+      PrintFixed(0, static_cast<double>(N) / elapsed, "\n");
+    }
+  }
+
+  return 0;
+}
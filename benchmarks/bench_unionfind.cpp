@@ -0,0 +1,96 @@
+/***************************************************************************
+
+  Copyright 2016-2020 Tom Furnival
+
+  This file is part of ctrwfractal.
+
+  ctrwfractal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ctrwfractal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ctrwfractal.  If not, see <http://www.gnu.org/licenses/>.
+
+  Benchmark of the union-find path compression strategies in Percolate
+  and GroupClusters, on the square lattice over a range of grid sizes and
+  thresholds. The strategy is fixed at compile time, so build once per
+  strategy from the repository root with:
+
+    g++ -O3 -std=c++11 -march=native -pthread -I ctrwfractal \
+        benchmarks/bench_unionfind.cpp -o bench_full -larmadillo
+    g++ -O3 -std=c++11 -march=native -pthread -I ctrwfractal \
+        -DCTRW_FIND_HALVING \
+        benchmarks/bench_unionfind.cpp -o bench_halving -larmadillo
+    g++ -O3 -std=c++11 -march=native -pthread -I ctrwfractal \
+        -DCTRW_FIND_SPLITTING \
+        benchmarks/bench_unionfind.cpp -o bench_splitting -larmadillo
+
+  Usage: ./bench_full [maxGridSize=8192] [nRepeats=3]
+
+***************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "_ctrw.hpp"
+
+#if defined(CTRW_FIND_HALVING)
+const char *strategy = "halving";
+#elif defined(CTRW_FIND_SPLITTING)
+const char *strategy = "splitting";
+#else
+const char *strategy = "full";
+#endif
+
+int main(int argc, char **argv)
+{
+  const uint64_t maxGridSize = (argc > 1) ? std::atoll(argv[1]) : 8192;
+  const uint64_t nRepeats = (argc > 2) ? std::atoll(argv[2]) : 3;
+
+  const double thresholds[4] = {0.5, 0.592746, 0.7, 0.9};
+  std::ostringstream sink;
+
+  PrintFixed(0, "strategy\tgridSize\tthreshold\tpercolateSeconds\tgroupSeconds\n");
+
+  for (uint64_t gridSize = 256; gridSize <= maxGridSize; gridSize *= 2)
+  {
+    for (const double threshold : thresholds)
+    {
+      double percolateTime = 1e300, groupTime = 1e300; // Best of nRepeats
+
+      for (uint64_t r = 0; r < nRepeats; r++)
+      {
+        CTRWfractal<double, int32_t> sim(gridSize, 0, threshold, 0,
+                                         0, 0, 0.0, 1.0, 0.0, 1 + r, 0, 0, 0, 0);
+
+        std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf()); // Silence stage timings
+        sim.FindNeighbours();
+        sim.Permute();
+
+        auto t0 = GetTime();
+        sim.Percolate();
+        auto t1 = GetTime();
+        sim.GroupClusters();
+        auto t2 = GetTime();
+        std::cout.rdbuf(coutBuf);
+
+        percolateTime = std::min(percolateTime, ElapsedSeconds(t0, t1));
+        groupTime = std::min(groupTime, ElapsedSeconds(t1, t2));
+        sink.str("");
+      }
+
+      PrintFixed(6, strategy, "\t", gridSize, "\t", threshold, "\t",
+                 percolateTime, "\t", groupTime, "\n");
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+/***************************************************************************
+
+  Copyright 2016-2020 Tom Furnival
+
+  This file is part of ctrwfractal.
+
+  ctrwfractal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ctrwfractal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ctrwfractal.  If not, see <http://www.gnu.org/licenses/>.
+
+  Benchmark of the random walk kernel in lattice steps per second, for
+  the square and honeycomb lattices at their critical thresholds. Build
+  from the repository root with:
+
+    g++ -O3 -std=c++11 -march=native -pthread -I ctrwfractal \
+        benchmarks/bench_walks.cpp -o bench_walks -larmadillo
+
+  Usage: ./bench_walks [maxGridSize=4096] [nWalks=100] [nSteps=10000] [nJobs=0]
+                      [beta=0] [tau0=1]
+
+  For a before/after comparison, build the benchmark from two revisions
+  (e.g. with git worktree) and run both with the same arguments.
+
+***************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "_ctrw.hpp"
+
+int main(int argc, char **argv)
+{
+  const uint64_t maxGridSize = (argc > 1) ? std::atoll(argv[1]) : 4096;
+  const uint64_t nWalks = (argc > 2) ? std::atoll(argv[2]) : 100;
+  const uint64_t nSteps = (argc > 3) ? std::atoll(argv[3]) : 10000;
+  const int64_t nJobs = (argc > 4) ? std::atoll(argv[4]) : 0;
+  const double beta = (argc > 5) ? std::atof(argv[5]) : 0.0;
+  const double tau0 = (argc > 6) ? std::atof(argv[6]) : 1.0;
+
+  const char *latticeNames[2] = {"square", "honeycomb"};
+  const double thresholds[2] = {0.592746, 0.697040230};
+  std::ostringstream sink;
+
+  PrintFixed(0, "lattice\tgridSize\tseconds\tstepsPerSecond\n");
+
+  for (uint64_t latticeType = 0; latticeType < 2; latticeType++)
+  {
+    for (uint64_t gridSize = 256; gridSize <= maxGridSize; gridSize *= 2)
+    {
+      CTRWfractal<double, int32_t> sim(gridSize, latticeType, thresholds[latticeType], 0,
+                                       nWalks, nSteps, beta, tau0, 0.0, 1, nJobs, 0, 0, 0);
+
+      std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf()); // Silence stage timings
+      sim.FindNeighbours();
+      sim.Permute();
+      sim.Percolate();
+      sim.BuildLattice();
+      sim.GroupClusters();
+      sim.RelabelClusters();
+      sim.BuildClusterIndex();
+      sim.BuildOccupancy();
+
+      auto t0 = GetTime();
+      sim.RandomWalks();
+      auto t1 = GetTime();
+      std::cout.rdbuf(coutBuf);
+
+      double elapsed = ElapsedSeconds(t0, t1);
+      PrintFixed(0, latticeNames[latticeType], "\t", gridSize, "\t");
+      PrintFixed(6, elapsed, "\t");
+      PrintFixed(0, static_cast<double>(nWalks * nSteps) / elapsed, "\n");
+    }
+  }
+
+  return 0;
+}
@@ -27,17 +27,29 @@
 #ifndef _CTRW_HPP
 #define _CTRW_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
+#include <map>
+#include <memory>
 #include <random>
+#include <stdexcept>
+#include <type_traits>
 #include <armadillo>
 
 #include "utils/pcg_random.hpp"
 #include "utils/utils.hpp"
 
-template <typename T>
+// T is the coordinate type and I the signed site index type, a 32-bit I
+// being valid for up to 2^31 - 2 sites. For a given randomSeed, the
+// results do not depend on nJobs.
+template <typename T, typename I = int64_t>
 class CTRWfractal
 {
+  static_assert(std::is_integral<I>::value && std::is_signed<I>::value,
+                "Site index type must be a signed integer");
+
 public:
   CTRWfractal(
       const uint64_t gridSize,
@@ -50,7 +62,10 @@ public:
       const double tau0,
       const double noise,
       const int64_t randomSeed,
-      const int64_t nJobs) : gridSize(gridSize),
+      const int64_t nJobs,
+      const uint64_t siteOrder,
+      const uint64_t percolationType,
+      const uint64_t occupancy) : gridSize(gridSize),
                              latticeType(latticeType),
                              threshold(threshold),
                              walkType(walkType),
@@ -60,17 +75,46 @@ public:
                              tau0(tau0),
                              noise(noise),
                              randomSeed(randomSeed),
-                             nJobs(nJobs)
+                             nJobs(nJobs),
+                             siteOrder(siteOrder),
+                             percolationType(percolationType),
+                             occupancy(occupancy)
   {
     includeWalks = ((nWalks > 0) && (nSteps > 0));
 
+    // 32-bit site indices store the cell displacements as int16_t, which
+    // is only exact below 2^30 sites (see parentCells)
+    const uint64_t nSites = ((latticeType == 1) ? 4 : 1) * gridSize * gridSize;
+    if (sizeof(I) < 8 && nSites >= (static_cast<uint64_t>(1) << 30))
+    {
+      throw std::invalid_argument("Lattice too large for 32-bit site indices");
+    }
+
+    // Site ordering in memory
+    //  - siteOrder = 0 : column-major
+    //  - siteOrder = 1 : Morton (Z-order), if gridSize is a power of 2
+    gridBits = 0;
+    while ((static_cast<uint64_t>(1) << gridBits) < gridSize)
+    {
+      gridBits++;
+    }
+    if ((static_cast<uint64_t>(1) << gridBits) != gridSize)
+    {
+      this->siteOrder = 0;
+    }
+
+    // Site occupation
+    //  - occupancy = 0 : exactly threshold * nItems, from a permutation
+    //  - occupancy = 1 : independently with probability threshold (site only)
+    if (percolationType != 0)
+    {
+      this->occupancy = 0;
+    }
+
     if (includeWalks) // Set array sizes
     {
       simLength = (tau0 < 1.0) ? static_cast<uint64_t>(nSteps / tau0) : nSteps;
 
-      walks.set_size(simLength);
-      ctrwTimes.set_size(simLength);
-      trueWalks.set_size(nSteps);
       eaMSD.set_size(nSteps);
       eaMSDall.set_size(nSteps - 1, nWalks);
       taMSD.set_size(nSteps - 1, nWalks);
@@ -82,9 +126,6 @@ public:
     {
       simLength = 0;
 
-      walks.set_size(0);
-      ctrwTimes.set_size(0);
-      trueWalks.set_size(0);
       eaMSD.set_size(0);
       eaMSDall.set_size(0, 0);
       taMSD.set_size(0, 0);
@@ -93,6 +134,18 @@ public:
       ergodicity.set_size(0);
     }
 
+    for (uint8_t mask = 0; mask < 16; mask++) // Occupied-neighbour mask to (count, slots) lookup table
+    {
+      stepCount[mask] = 0;
+      for (uint8_t k = 0; k < 4; k++)
+      {
+        if (mask & (1 << k))
+        {
+          stepSlot[mask][stepCount[mask]++] = k;
+        }
+      }
+    }
+
     if (randomSeed < 0) // Seed with external entropy from std::random_device
     {
       RNG.seed(pcg_extras::seed_seq_from<std::random_device>());
@@ -105,9 +158,6 @@ public:
 
   ~CTRWfractal()
   {
-    walks.reset();
-    ctrwTimes.reset();
-    trueWalks.reset();
     eaMSD.reset();
     eaMSDall.reset();
     taMSD.reset();
@@ -115,10 +165,21 @@ public:
     eataMSDall.reset();
     ergodicity.reset();
     nn.reset();
+    nnCells.reset();
     lattice.reset();
+    parentCells.reset();
     occupation.reset();
+    occupied.reset();
+    neighbourMasks.reset();
     latticeCoords.reset();
     analysis.reset();
+    sweep.reset();
+    sizeDistribution.reset();
+    clusterRadii.reset();
+    clusterIds.reset();
+    clusterSizes.reset();
+    clusterMembers.reset();
+    clusterOffsets.reset();
     walksCoords.reset();
   };
 
@@ -133,37 +194,27 @@ public:
       neighbourCount = 3;
       N = 4 * gridSize * gridSize;
 
+#ifndef CTRW_IMPLICIT_NEIGHBOURS
       nn.set_size(neighbourCount, N);
-      firstRow.set_size(2 * gridSize);
-      lastRow.set_size(2 * gridSize);
-
-      for (size_t i = 1; i <= 2 * gridSize; i++)
-      {
-        firstRow(i - 1) = 1 - 0.5 * (3 * gridSize) + 0.5 * (std::pow(-1, i) * gridSize) + 2 * i * gridSize - 1;
-        lastRow(i - 1) = 0.5 * gridSize * (4 * i + std::pow(-1, i + 1) - 1) - 1;
-      }
+      nnCells.set_size(neighbourCount, N);
       BoundariesHoneycomb();
+#endif
       break;
     case 0:
     default:
       neighbourCount = 4;
       N = gridSize * gridSize;
 
+#ifndef CTRW_IMPLICIT_NEIGHBOURS
       nn.set_size(neighbourCount, N);
-      firstRow.set_size(gridSize);
-      lastRow.set_size(gridSize);
-
-      for (size_t i = 1; i <= gridSize; i++)
-      {
-        firstRow(i - 1) = (i - 1) * gridSize - 1;
-        lastRow(i - 1) = (i - 1) * gridSize;
-      }
+      nnCells.set_size(neighbourCount, N);
       BoundariesSquare();
+#endif
       break;
     }
 
-    EMPTY = (-1 * static_cast<int64_t>(N) - 1); // Define empty index
-    lattice.set_size(N);                        // Set array sizes
+    EMPTY = (-1 * static_cast<I>(N) - 1); // Define empty index
+    lattice.set_size(N);                  // Set array sizes
     clusters.set_size(N);
     occupation.set_size(N);
     latticeCoords.set_size(2, N);
@@ -190,18 +241,79 @@ public:
     PrintFixed(0, "Randomizing occupations... ");
     t0 = GetTime();
 
-    int64_t j, t_;
+    // Parallel shuffle: each block scatters its items to random buckets,
+    // then each bucket is shuffled (see ShuffleBuckets)
+    arma::Col<I> items;
+    if (occupancy == 1) // No permutation is needed
+    {
+      occupation.reset();
+      nItems = N;
+
+      t1 = GetTime();
+      PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+      return;
+    }
+    else if (percolationType == 1)
+    {
+      BuildBonds();
+      items = occupation;
+      nItems = items.n_elem;
+    }
+    else
+    {
+      occupation.set_size(N);
+      nItems = N;
+    }
+
+    const uint64_t nBlocks = permBlocks;
+    const uint64_t blockSize = (nItems + nBlocks - 1) / nBlocks;
+    permSeed = RNG();
+    std::vector<uint64_t> offsets(nBlocks * nBlocks + 1, 0); // Indexed by bucket * nBlocks + block
+
+    auto &&count = [&](uint64_t b) {
+      pcg64 blockRNG(permSeed, b);
+      const uint64_t last = std::min(nItems, (b + 1) * blockSize);
+      for (uint64_t i = b * blockSize; i < last; i++)
+      {
+        offsets[(blockRNG() >> (64 - permBits)) * nBlocks + b + 1]++; // The top bits pick the bucket
+      }
+    };
+    parallel(count, static_cast<uint64_t>(0), nBlocks, nJobs);
 
-    occupation = arma::regspace<arma::ivec>(0, N - 1);
+    for (size_t k = 0; k < nBlocks * nBlocks; k++)
+    {
+      offsets[k + 1] += offsets[k];
+    }
 
-    for (size_t i = 0; i < N; i++)
+    // Repeat the draws to scatter the items, listing sites in column-major
+    // order so the same sites are occupied under any site ordering
+    auto &&scatter = [&](uint64_t b) {
+      pcg64 blockRNG(permSeed, b);
+      uint64_t cursor[permBlocks];
+      for (size_t c = 0; c < nBlocks; c++)
+      {
+        cursor[c] = offsets[c * nBlocks + b];
+      }
+
+      const uint64_t last = std::min(nItems, (b + 1) * blockSize);
+      for (uint64_t i = b * blockSize; i < last; i++)
+      {
+        const uint64_t c = blockRNG() >> (64 - permBits);
+        occupation(cursor[c]++) = (percolationType == 1) ? items(i) : static_cast<I>(SiteIndex(i / gridSize, i % gridSize));
+      }
+    };
+    parallel(scatter, static_cast<uint64_t>(0), nBlocks, nJobs);
+
+    bucketStarts.resize(nBlocks + 1);
+    for (size_t c = 0; c <= nBlocks; c++)
     {
-      j = i + (N - i) * permConstant * UniformDistribution(RNG);
-      t_ = occupation(i);
-      occupation(i) = occupation(j);
-      occupation(j) = t_;
+      bucketStarts[c] = offsets[c * nBlocks];
     }
 
+    // Only the prefix read by Percolate is shuffled, the rest on demand
+    nPermuted = 0;
+    ShuffleBuckets(OccupiedCount(threshold));
+
     t1 = GetTime();
     PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
   }
@@ -211,53 +323,217 @@ public:
     PrintFixed(0, "Running percolation...     ");
     t0 = GetTime();
 
-    int64_t s1, s2;
-    int64_t r1, r2;
-    int64_t big = 0;
+    if (occupancy == 1)
+    {
+      PercolateBernoulli();
+    }
+    else
+    {
+      ResetPercolation();
+      AddItems(OccupiedCount(threshold));
+    }
+
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
+  void Advance(const double newThreshold)
+  {
+    PrintFixed(0, "Advancing percolation...   ");
+    t0 = GetTime();
+
+    // Continue to a higher threshold, adding only the sites (or bonds) in
+    // between. Lower thresholds and Bernoulli occupation are ignored
+    if (occupancy == 1)
+    {
+      t1 = GetTime();
+      PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+      return;
+    }
+
+    threshold = std::max(threshold, newThreshold);
+    if (parentCells.n_elem == 0) // Untracked after PercolateParallel
+    {
+      parentCells.zeros(2, N);
+    }
+    AddItems(OccupiedCount(threshold));
+
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
+  void PercolateParallel()
+  {
+    PrintFixed(0, "Running percolation...     ");
+    t0 = GetTime();
+
+    // Parallel labelling with a lock-free union-find. Same partition as
+    // Percolate, but wrapping is not tracked
+    const uint64_t nOcc = OccupiedCount(threshold);
+    std::unique_ptr<std::atomic<I>[]> parent(new std::atomic<I>[N]);
+
+    ResetPercolation(false);
+    nOccupied = nOcc;
+    nClusters = 0; // Counted from the roots below
+    sumSquares = 0.0;
 
-    lattice.fill(EMPTY);
+    auto &&init = [&](uint64_t i) { parent[i].store(static_cast<I>(i), std::memory_order_relaxed); };
+    parallel(init, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
 
-    for (uint64_t i = 0; i < (threshold * N) - 1; i++)
+    if (percolationType == 1) // Every site is in a cluster, the bonds are unioned
     {
-      r1 = s1 = occupation[i];
-      lattice(s1) = -1;
+      auto &&uniteBonds = [&](uint64_t k) {
+        I buffer[4];
+        const I i = occupation(k) / neighbourCount;
+        UniteAtomic(parent.get(), i, Neighbours(i, buffer)[occupation(k) % neighbourCount]);
+      };
+      ShuffleBuckets(nOcc);
+      parallel(uniteBonds, static_cast<uint64_t>(0), nOcc, nJobs);
+    }
+    else
+    {
+      auto &&occupy = [&](uint64_t k) { lattice(occupation(k)) = -1; };
+      if (occupancy == 1)
+      {
+        nOccupied = OccupyBernoulli();
+      }
+      else
+      {
+        ShuffleBuckets(nOcc);
+        parallel(occupy, static_cast<uint64_t>(0), nOcc, nJobs);
+      }
+    }
+
+    auto &&unite = [&](uint64_t i) {
+      if (lattice(i) == EMPTY)
+      {
+        return;
+      }
+      I buffer[4];
+      const I *neighbours = Neighbours(i, buffer);
       for (size_t j = 0; j < neighbourCount; j++)
       {
-        s2 = nn(j, s1);
-        if (lattice(s2) != EMPTY)
+        if (static_cast<uint64_t>(neighbours[j]) > i && lattice(neighbours[j]) != EMPTY)
         {
-          r2 = FindRoot(s2);
-          if (r2 != r1)
-          {
-            if (lattice(r1) > lattice(r2))
-            {
-              lattice(r2) += lattice(r1);
-              lattice(r1) = r2;
-              r1 = r2;
-            }
-            else
-            {
-              lattice(r1) += lattice(r2);
-              lattice(r2) = r1;
-            }
-            if (-lattice(r1) > big)
-            {
-              big = -lattice(r1);
-            }
-          }
+          UniteAtomic(parent.get(), static_cast<I>(i), neighbours[j]);
+        }
+      }
+    };
+    if (percolationType == 0)
+    {
+      parallel(unite, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+    }
+
+    // Flatten to the roots, then count the cluster sizes into parent
+    auto &&flatten = [&](uint64_t i) {
+      if (lattice(i) != EMPTY)
+      {
+        lattice(i) = FindRootAtomic(parent.get(), static_cast<I>(i));
+      }
+    };
+    parallel(flatten, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+
+    auto &&reset = [&](uint64_t i) { parent[i].store(0, std::memory_order_relaxed); };
+    parallel(reset, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+
+    auto &&count = [&](uint64_t i) {
+      if (lattice(i) != EMPTY)
+      {
+        parent[lattice(i)].fetch_add(1, std::memory_order_relaxed);
+      }
+    };
+    parallel(count, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+
+    // Store the negated sizes at the roots, reducing the cluster
+    // statistics over fixed blocks of sites
+    const uint64_t nBlocks = 256;
+    const uint64_t blockSize = (N + nBlocks - 1) / nBlocks;
+    std::vector<uint64_t> blockLargest(nBlocks, 0), blockClusters(nBlocks, 0);
+    std::vector<double> blockSquares(nBlocks, 0.0);
+
+    auto &&roots = [&](uint64_t b) {
+      const uint64_t last = std::min(N, (b + 1) * blockSize);
+      for (uint64_t i = b * blockSize; i < last; i++)
+      {
+        if (lattice(i) == static_cast<I>(i))
+        {
+          const uint64_t size = parent[i].load(std::memory_order_relaxed);
+          lattice(i) = -static_cast<I>(size);
+          blockLargest[b] = std::max(blockLargest[b], size);
+          blockClusters[b]++;
+          blockSquares[b] += static_cast<double>(size) * static_cast<double>(size);
         }
       }
+    };
+    parallel(roots, static_cast<uint64_t>(0), nBlocks, nJobs);
+
+    for (size_t b = 0; b < nBlocks; b++)
+    {
+      largestCluster = std::max(largestCluster, blockLargest[b]);
+      nClusters += blockClusters[b];
+      sumSquares += blockSquares[b];
+    }
+
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
+  void Sweep(const arma::Col<T> &thresholds)
+  {
+    PrintFixed(0, "Running percolation sweep..");
+    t0 = GetTime();
+
+    // Newman-Ziff sweep, recording the statistics at each threshold,
+    // or after every added site if no thresholds are given
+    I buffer[4];
+    uint8_t cellBuffer[4];
+    uint64_t n = 0, target;
+    uint64_t nRecords = (thresholds.n_elem > 0) ? thresholds.n_elem : nItems;
+
+    sweep.set_size(7, nRecords);
+    ResetPercolation();
+    ShuffleBuckets((thresholds.n_elem > 0) ? OccupiedCount(arma::max(thresholds)) : nItems);
+
+    for (size_t r = 0; r < nRecords; r++)
+    {
+      target = (thresholds.n_elem > 0) ? OccupiedCount(thresholds(r)) : r + 1;
+      for (; n < target; n++)
+      {
+        AddItem(occupation[n], buffer, cellBuffer);
+      }
+
+      const double nSites = (percolationType == 1) ? N : n;    // Sites in clusters
+      sweep(0, r) = static_cast<T>(n) / nItems;                 // Occupied fraction
+      sweep(1, r) = n;                                          // Occupied sites or bonds
+      sweep(2, r) = largestCluster;                             // Largest cluster size
+      sweep(3, r) = (nSites > 0) ? sumSquares / nSites : 0.0;   // Mean size of the cluster containing a site
+      sweep(4, r) = nClusters;                                  // Number of clusters
+      sweep(5, r) = (wrapping[0] > 0);                          // A cluster wraps in x
+      sweep(6, r) = (wrapping[1] > 0);                          // A cluster wraps in y
     }
 
     t1 = GetTime();
     PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
   }
 
+  void BuildOccupancy()
+  {
+    PrintFixed(0, "Building occupancy...      ");
+    t0 = GetTime();
+
+    PackOccupancy();
+
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
   void BuildLattice()
   {
     PrintFixed(0, "Building lattice...        ");
     t0 = GetTime();
 
+    coordsRestored = false;
+
     uint64_t count;
 
     switch (latticeType)
@@ -265,7 +541,6 @@ public:
     case 1: // Populate honeycomb lattice coordinates
       double xx, yy;
       uint64_t currentCol, xOffset, yOffset;
-      count = 0;
 
       for (size_t i = 0; i < 4 * gridSize; i++)
       {
@@ -295,27 +570,25 @@ public:
             yy = yOffset * sqrt3 + sqrt3o2;
             break;
           }
+          count = SiteIndex(i, j);
           latticeCoords(0, count) = xx;
           latticeCoords(1, count) = yy;
-          count++;
         }
       }
 
       unitCell = arma::max(latticeCoords, 1); // Get unit cell size
-      unitCell(0) += 1.5;
+      unitCell(0) += 1.0;
       unitCell(1) += sqrt3o2;
       break;
     case 0: // Populate square lattice coordinates
     default:
-      count = 0;
-
       for (size_t i = 0; i < gridSize; i++)
       {
         for (size_t j = 0; j < gridSize; j++)
         {
+          count = SiteIndex(i, j);
           latticeCoords(0, count) = i;
           latticeCoords(1, count) = j;
-          count++;
         }
       }
 
@@ -336,136 +609,97 @@ public:
 
     PossibleStartPoints(); // Populate start points
 
-    std::uniform_int_distribution<uint32_t> RandSample(0, static_cast<uint32_t>(latticeOnes.n_elem) - 1);
-
-    arma::uvec boundaryDetect(simLength);
-    arma::uvec boundaryTrue(simLength);
-    int64_t boundary1 = static_cast<int64_t>(gridSize);
-    int64_t boundary2 = static_cast<int64_t>(N) - boundary1;
-
-    for (size_t i = 0; i < nWalks; i++) // Simulate a random walk on the lattice
-    {
-      uint64_t countLoop = 0;
-      uint64_t countMax = std::min(N, static_cast<uint64_t>(1E6)); // Maximum attempts to find a starting site
-
-      int64_t pos, posLast;
-      bool okStart = false;
-      arma::ivec neighbours;
-
-      do // Search for a random start position
-      {
-        pos = latticeOnes(RandSample(RNG));
-        neighbours = GetOccupiedNeighbours(pos);
-
-        if (neighbours.n_elem > 0 || countLoop >= countMax) // Check start position has >= 1 occupied nearest neighbours
-        {
-          okStart = true;
-        }
-        else
-        {
-          countLoop++;
-        }
-      } while (!okStart);
-
-      if (countLoop == countMax) // If no nearest neighbours, set the whole walk to that site
+    // Each thread steps a batch of walkers in lock-step, each walker with
+    // its own pcg streams, subordinating the walk to the CTRW as it goes
+    const uint64_t walkSeed = RNG();
+    const uint64_t timeSeed = RNG();
+    const uint64_t nThreads = (nJobs > 0) ? nJobs : ((nJobs < 0) ? std::max(1U, std::thread::hardware_concurrency()) : 1);
+    const uint64_t perThread = (nWalks + nThreads - 1) / nThreads;
+    const uint64_t batchSize = (perThread < 1) ? 1 : ((perThread < walkBatch) ? perThread : walkBatch);
+    const uint64_t nBatches = (nWalks + batchSize - 1) / batchSize;
+    const uint64_t countMax = std::min(N, static_cast<uint64_t>(1E6)); // Maximum attempts to find a starting site
+
+    auto &&batch = [&](uint64_t b) {
+      const uint64_t first = b * batchSize;
+      const uint64_t count = std::min(batchSize, nWalks - first);
+
+      pcg64 walkRNG[walkBatch], timeRNG[walkBatch];
+      I pos[walkBatch];
+      int32_t cellX[walkBatch], cellY[walkBatch];
+      uint64_t nJumps[walkBatch];
+      T jumpTime[walkBatch];
+      bool stuck[walkBatch];
+      std::exponential_distribution<double> ExponentialDistribution((beta > 0.) ? beta : 1.0);
+      I buffer[4];
+      uint8_t cellBuffer[4];
+      uint8_t mask, slot, cell;
+      const uint8_t *cells;
+
+      // Time of the next jump of walker k, past nSteps once it stops
+      auto &&nextTime = [&](size_t k, const T previous) -> T {
+        T time = (beta > 0.) ? previous + tau0 * std::exp(ExponentialDistribution(timeRNG[k])) : previous + 1;
+        return (time >= nSteps || nJumps[k] + 1 >= simLength) ? static_cast<T>(nSteps) : time;
+      };
+
+      for (size_t k = 0; k < count; k++) // Search for a random start position
       {
-        walks.fill(pos);
-        boundaryDetect.zeros();
-      }
-      else
-      {
-        posLast = pos;
-        walks(0) = pos;
-        boundaryDetect(0) = 0;
-
-        for (size_t j = 1; j < simLength; j++)
+        walkRNG[k] = pcg64(walkSeed, first + k);
+        timeRNG[k] = pcg64(timeSeed, first + k);
+        cellX[k] = 0;
+        cellY[k] = 0;
+        nJumps[k] = 0;
+        uint64_t countLoop = 0;
+        bool okStart = false;
+
+        do
         {
-          neighbours = GetOccupiedNeighbours(pos);
-          std::uniform_int_distribution<uint32_t> RandChoice(0, static_cast<uint32_t>(neighbours.n_elem) - 1);
-          pos = neighbours(RandChoice(RNG));
-          walks(j) = pos;
+          pos[k] = clusterMembers(startBegin + BoundedRand(walkRNG[k], startCount));
 
-          if (arma::any(firstRow == posLast) && arma::any(lastRow == pos)) // Walks that hit the top boundary
-          {
-            boundaryDetect(j) = 1;
-          }
-          else if (arma::any(lastRow == posLast) && arma::any(firstRow == pos)) // Walks that hit the bottom boundary
-          {
-            boundaryDetect(j) = 2;
-          }
-          else if (posLast >= boundary2 && pos < boundary1) // Walks that hit the right boundary
+          if (NeighbourMask(pos[k]) > 0 || countLoop >= countMax) // Check start position has >= 1 occupied nearest neighbours
           {
-            boundaryDetect(j) = 3;
-          }
-          else if (posLast < boundary1 && pos >= boundary2) // Walks that hit the left boundary
-          {
-            boundaryDetect(j) = 4;
+            okStart = true;
           }
           else
           {
-            boundaryDetect(j) = 0;
+            countLoop++;
           }
+        } while (!okStart);
 
-          posLast = pos; // Update last position
-        }
-      }
-
-      ctrwTimes.set_size(simLength);
-      if (beta > 0.)
-      {
-        std::exponential_distribution<double> ExponentialDistribution(beta); // Create exponential distribution
-        ctrwTimes.imbue([&]() { return ExponentialDistribution(RNG); });     // Draw CTRW random variates
-        ctrwTimes = arma::cumsum(tau0 * arma::exp(ctrwTimes));               // Transform to Pareto distribution and accumulate
-      }
-      else
-      {
-        ctrwTimes = arma::linspace<arma::vec>(1, simLength, simLength);
+        stuck[k] = (countLoop == countMax); // If no nearest neighbours, the walker stays at that site
+        jumpTime[k] = nextTime(k, 0);
+        PrefetchSite(pos[k]);
       }
 
-      arma::uvec boundaryTime_ = arma::find(ctrwTimes >= nSteps, 1, "first"); // Only keep times within range [0, nSteps]
-      int64_t boundaryTime = boundaryTime_(0);
-      ctrwTimes = ctrwTimes(arma::span(0, boundaryTime));
-      ctrwTimes(boundaryTime) = nSteps;
-
-      uint64_t counter = 0;
-      boundaryTrue.zeros();
-
       for (size_t j = 0; j < nSteps; j++) // Subordinate fractal walk with CTRW
       {
-        if (j > ctrwTimes(counter))
+        for (size_t k = 0; k < count; k++)
         {
-          counter++;
-          boundaryTrue(j) = boundaryDetect(counter);
-        }
-        trueWalks(j) = walks(counter);
-      }
+          while (j > jumpTime[k])
+          {
+            nJumps[k]++;
+            jumpTime[k] = nextTime(k, jumpTime[k]);
 
-      int64_t nxCell = 0;
-      int64_t nyCell = 0;
-      for (size_t n = 0; n < nSteps; n++) // Convert the walk to the coordinate system
-      {
-        switch (boundaryTrue(n))
-        {
-        case 1:
-          nyCell++;
-          break;
-        case 2:
-          nyCell--;
-          break;
-        case 3:
-          nxCell++;
-          break;
-        case 4:
-          nxCell--;
-          break;
-        case 0:
-        default:
-          break;
+            if (!stuck[k])
+            {
+              mask = NeighbourMask(pos[k]); // Pick one of the occupied neighbours
+              slot = stepSlot[mask][BoundedRand(walkRNG[k], stepCount[mask])];
+              pos[k] = NeighboursAndCells(pos[k], buffer, cellBuffer, cells)[slot];
+              cell = cells[slot]; // Unit cells crossed by this edge
+              cellX[k] += CellX(cell);
+              cellY[k] += CellY(cell);
+              PrefetchSite(pos[k]);
+            }
+          }
+
+          // Convert the walk to the coordinate system, unwrapping the
+          // periodic boundaries with the unit cells crossed so far
+          walksCoords(0, j, first + k) = latticeCoords(0, pos[k]) + cellX[k] * unitCell(0);
+          walksCoords(1, j, first + k) = latticeCoords(1, pos[k]) + cellY[k] * unitCell(1);
         }
-        walksCoords(0, n, i) = latticeCoords(0, trueWalks(n)) + nxCell * unitCell(0);
-        walksCoords(1, n, i) = latticeCoords(1, trueWalks(n)) + nyCell * unitCell(1);
       }
-    }
+    };
+
+    parallel(batch, static_cast<uint64_t>(0), nBatches, nJobs);
 
     t1 = GetTime();
     PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
@@ -534,10 +768,12 @@ public:
       PrintFixed(0, "Adding noise...            ");
       t0 = GetTime();
 
-      arma::cube noiseCube(size(walksCoords));
       std::normal_distribution<double> NormalDistribution(0, noise);
-      noiseCube.imbue([&]() { return NormalDistribution(RNG); });
-      walksCoords += noiseCube;
+      T *coords = walksCoords.memptr(); // Add the noise in place
+      for (size_t k = 0; k < walksCoords.n_elem; k++)
+      {
+        coords[k] += NormalDistribution(RNG);
+      }
 
       t1 = GetTime();
       PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
@@ -547,7 +783,7 @@ public:
   void GroupClusters()
   {
     clusters = lattice;
-    int64_t j;
+    I j;
     for (size_t i = 0; i < N; i++)
     {
       //PrintFixed(0, i, " ", clusters(i), " ");
@@ -560,219 +796,1582 @@ public:
     }
   }
 
-  bool includeWalks;
-  arma::Col<int64_t> lattice, clusters;
-  arma::Mat<T> latticeCoords, analysis;
-  arma::Cube<T> walksCoords;
-
-private:
-  uint64_t gridSize, latticeType;
-  double threshold;
-  uint64_t walkType, nWalks, nSteps;
-  double beta, tau0, noise;
-  int64_t randomSeed, nJobs;
-
-  uint64_t N, simLength;
-  int64_t EMPTY;
-  uint8_t neighbourCount;
+  void ClusterStatistics()
+  {
+    PrintFixed(0, "Cluster statistics...      ");
+    t0 = GetTime();
 
-  const double sqrt3 = 1.7320508075688772;
-  const double sqrt3o2 = 0.8660254037844386;
+    // Size histogram and radius of gyration of every cluster in O(N),
+    // from exact integer moments of the unwrapped sites
+    UnwrapClusters();
+
+    const int64_t cellX = (latticeType == 1) ? 6 * gridSize : gridSize;
+    const int64_t cellY = (latticeType == 1) ? 2 * gridSize : gridSize;
+    const double scaleX = (latticeType == 1) ? 0.5 : 1.0;
+    const double scaleY = (latticeType == 1) ? sqrt3o2 : 1.0;
+
+    // Number the clusters as in RelabelClusters, so column k of
+    // clusterRadii is the cluster with id k
+    const uint64_t nBlocks = 256;
+    const uint64_t blockSize = (N + nBlocks - 1) / nBlocks;
+    arma::Col<I> rootIds;
+    const uint64_t K = RankClusters(rootIds);
+
+    // Sums of x, y, x^2 and y^2 relative to each root, the squares kept
+    // in 128 bits as (low, high) words
+    std::unique_ptr<std::atomic<uint64_t>[]> moments(new std::atomic<uint64_t>[6 * K]);
+    for (uint64_t m = 0; m < 6 * K; m++)
+    {
+      moments[m].store(0, std::memory_order_relaxed);
+    }
 
-  const uint32_t maxSites = 4294967294;      // Max uint32_t
-  const double permConstant = 2.3283064e-10; // Equal to 1 / maxSites (max uint32_t)
+    auto &&accumulate = [&](uint64_t b) {
+      const uint64_t last = std::min(N, (b + 1) * blockSize);
+      uint64_t run[4] = {0, 0, 0, 0}; // x and y sums wrap as two's complement
+      int64_t rootX = 0, rootY = 0;
+      I current = -1;
+      int32_t dx, dy;
 
-  arma::ivec occupation, walks, trueWalks, firstRow, lastRow, latticeOnes;
-  arma::imat nn;
-  arma::Col<T> unitCell, ctrwTimes, eaMSD, eataMSD, ergodicity;
-  arma::Mat<T> eaMSDall, eataMSDall, taMSD;
+      auto &&addWide = [&](std::atomic<uint64_t> *sum, const uint64_t v) {
+        const uint64_t old = sum[0].fetch_add(v, std::memory_order_relaxed);
+        if (old + v < old)
+        {
+          sum[1].fetch_add(1, std::memory_order_relaxed);
+        }
+      };
 
-  pcg64 RNG;
-  std::uniform_int_distribution<uint32_t> UniformDistribution{0, maxSites};
-  std::chrono::high_resolution_clock::time_point t0, t1;
+      auto &&flush = [&]() {
+        if (current >= 0)
+        {
+          const uint64_t k = rootIds(current);
+          moments[6 * k].fetch_add(run[0], std::memory_order_relaxed);
+          moments[6 * k + 1].fetch_add(run[1], std::memory_order_relaxed);
+          addWide(&moments[6 * k + 2], run[2]);
+          addWide(&moments[6 * k + 4], run[3]);
+          run[0] = run[1] = run[2] = run[3] = 0;
+        }
+      };
 
-  inline int64_t FindRoot(const int64_t i)
-  {
-    return (lattice(i) < 0) ? i : lattice(i) = FindRoot(lattice(i));
-  };
+      for (uint64_t i = b * blockSize; i < last; i++)
+      {
+        if (lattice(i) == EMPTY)
+        {
+          continue;
+        }
 
-  inline int64_t GroupRoot(const int64_t i)
-  {
-    return (clusters(i) < 0) ? i : clusters(i) = GroupRoot(clusters(i));
-  };
+        const I root = FindRootReadOnly(static_cast<I>(i), dx, dy);
+        if (root != current)
+        {
+          flush();
+          current = root;
+          LatticeUnits(root, rootX, rootY);
+        }
 
-  void PossibleStartPoints()
-  {
-    latticeOnes = arma::regspace<arma::ivec>(0, N - 1);
+        int64_t x, y;
+        LatticeUnits(i, x, y);
+        x += dx * cellX - rootX;
+        y += dy * cellY - rootY;
+        run[0] += static_cast<uint64_t>(x);
+        run[1] += static_cast<uint64_t>(y);
+        run[2] += static_cast<uint64_t>(x * x);
+        run[3] += static_cast<uint64_t>(y * y);
+      }
+      flush();
+    };
+    parallel(accumulate, static_cast<uint64_t>(0), nBlocks, nJobs);
 
-    // Set up selection of random start point
-    //  - walkType = 1 : on largest cluster, or
-    //  - walkType = 0 : on ALL clusters
-    if (walkType == 1)
+    // Per-cluster (size, radius of gyration), and the size histogram
+    // counted over sizes up to the largest cluster
+    const uint64_t largest = largestCluster;
+    std::unique_ptr<std::atomic<uint64_t>[]> sizeCounts(new std::atomic<uint64_t>[largest + 1]);
+    for (uint64_t m = 0; m <= largest; m++)
     {
-      int64_t latticeMin = lattice.elem(find(lattice > EMPTY)).min();
-      arma::uvec idxMin = arma::find(lattice == latticeMin);
-      arma::uvec largestCluster = arma::find(lattice == idxMin(0));
-      uint64_t largestClusterSize = largestCluster.n_elem + 1;
-      largestCluster.resize(largestClusterSize);
-      largestCluster(largestClusterSize - 1) = idxMin(0);
-      latticeOnes = latticeOnes.elem(largestCluster);
+      sizeCounts[m].store(0, std::memory_order_relaxed);
     }
-    else
+
+    clusterRadii.set_size(2, K);
+
+    auto &&wide = [&](const uint64_t m) {
+      return std::ldexp(static_cast<double>(moments[m + 1].load(std::memory_order_relaxed)), 64) +
+             static_cast<double>(moments[m].load(std::memory_order_relaxed));
+    };
+
+    auto &&radii = [&](uint64_t b) {
+      const uint64_t last = std::min(N, (b + 1) * blockSize);
+      for (uint64_t i = b * blockSize; i < last; i++)
+      {
+        if (lattice(i) < 0 && lattice(i) != EMPTY)
+        {
+          const uint64_t k = rootIds(i);
+          const double n = static_cast<double>(-lattice(i));
+          const double mx = static_cast<int64_t>(moments[6 * k].load(std::memory_order_relaxed)) / n;
+          const double my = static_cast<int64_t>(moments[6 * k + 1].load(std::memory_order_relaxed)) / n;
+          const double vx = wide(6 * k + 2) / n - mx * mx;
+          const double vy = wide(6 * k + 4) / n - my * my;
+
+          clusterRadii(0, k) = n;
+          clusterRadii(1, k) = std::sqrt(std::max(0.0, scaleX * scaleX * vx + scaleY * scaleY * vy));
+          sizeCounts[-lattice(i)].fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    };
+    parallel(radii, static_cast<uint64_t>(0), nBlocks, nJobs);
+
+    uint64_t nSizes = 0;
+    for (uint64_t m = 1; m <= largest; m++)
     {
-      latticeOnes = latticeOnes.elem(find(lattice != EMPTY));
+      nSizes += (sizeCounts[m].load(std::memory_order_relaxed) > 0);
     }
-  };
 
-  arma::ivec GetOccupiedNeighbours(const int64_t pos)
-  {
-    arma::Col<uint8_t> checkNeighbour(neighbourCount, arma::fill::zeros);
-    arma::ivec neighbours = nn.col(pos);
-
-    for (size_t k = 0; k < neighbourCount; k++)
+    sizeDistribution.set_size(2, nSizes);
+    nSizes = 0;
+    for (uint64_t m = 1; m <= largest; m++)
     {
-      checkNeighbour(k) = (lattice(neighbours(k)) == EMPTY) ? 0 : 1;
+      const uint64_t count = sizeCounts[m].load(std::memory_order_relaxed);
+      if (count > 0)
+      {
+        sizeDistribution(0, nSizes) = m;
+        sizeDistribution(1, nSizes) = count;
+        nSizes++;
+      }
     }
 
-    return neighbours.elem(find(checkNeighbour == 1));
-  };
+    largestMass = largest;
 
-  void BoundariesHoneycomb()
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
+  void RelabelClusters()
   {
-    // Honeycomb lattice nearest neighbours with periodic boundary conditions
-    uint64_t currentCol = 0;
-    uint64_t count = 0;
+    PrintFixed(0, "Relabelling clusters...    ");
+    t0 = GetTime();
 
-    for (size_t i = 0; i < N; i++)
+    // Dense cluster ids 0..K-1 by decreasing size, -1 for empty sites
+    arma::Col<I> rank;
+    const uint64_t K = RankClusters(rank);
+
+    clusterIds.set_size(N);
+    clusterSizes.set_size(K);
+
+    auto &&func = [&](uint64_t k) {
+      const uint64_t i = SiteIndex(k / gridSize, k % gridSize);
+      if (lattice(i) == EMPTY)
+      {
+        clusterIds(k) = -1;
+        return;
+      }
+
+      const I root = FindRootReadOnly(static_cast<I>(i));
+      clusterIds(k) = rank(root);
+      if (root == static_cast<I>(i))
+      {
+        clusterSizes(rank(root)) = -lattice(i);
+      }
+    };
+    parallel(func, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
+  void BuildClusterIndex()
+  {
+    PrintFixed(0, "Indexing clusters...       ");
+    t0 = GetTime();
+
+    // Sites of cluster k, in column-major order, are clusterMembers from
+    // clusterOffsets(k) up to, not including, clusterOffsets(k + 1)
+    const uint64_t K = clusterSizes.n_elem;
+    clusterOffsets.set_size(K + 1);
+    clusterOffsets(0) = 0;
+    for (uint64_t k = 0; k < K; k++)
+    {
+      clusterOffsets(k + 1) = clusterOffsets(k) + clusterSizes(k);
+    }
+
+    std::vector<uint64_t> cursor(clusterOffsets.begin(), clusterOffsets.end() - 1);
+    clusterMembers.set_size(clusterOffsets(K));
+
+    for (uint64_t k = 0; k < N; k++)
+    {
+      const I id = clusterIds(k);
+      if (id >= 0)
+      {
+        clusterMembers(cursor[id]++) = static_cast<I>(SiteIndex(k / gridSize, k % gridSize));
+      }
+    }
+
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
+  void ClusterSites(const uint64_t label, arma::Col<int64_t> &sites) const
+  {
+    // Column-major indices of the sites in cluster label, which is empty
+    // if there is no such cluster
+    const uint64_t first = (label < clusterSizes.n_elem) ? clusterOffsets(label) : 0;
+    const uint64_t last = (label < clusterSizes.n_elem) ? clusterOffsets(label + 1) : 0;
+
+    sites.set_size(last - first);
+    for (uint64_t k = first; k < last; k++)
+    {
+      sites(k - first) = ColumnMajorIndex(clusterMembers(k));
+    }
+  }
+
+  void RestoreSiteOrder()
+  {
+    // Permute clusters and latticeCoords back to column-major order
+    if (siteOrder == 0)
+    {
+      return;
+    }
+
+    const bool coords = !coordsRestored;
+    arma::Col<I> clustersOut(N);
+    arma::Mat<T> coordsOut(2, coords ? N : 0);
+
+    auto &&func = [&](uint64_t k) {
+      uint64_t i = SiteIndex(k / gridSize, k % gridSize);
+      clustersOut(k) = clusters(i);
+      if (coords)
+      {
+        coordsOut(0, k) = latticeCoords(0, i);
+        coordsOut(1, k) = latticeCoords(1, i);
+      }
+    };
+    parallel(func, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+
+    clusters = clustersOut;
+    if (coords)
+    {
+      latticeCoords = coordsOut;
+      coordsRestored = true;
+    }
+  }
+
+  bool includeWalks;
+  arma::Col<I> lattice, clusters;
+  arma::Col<I> clusterIds, clusterSizes; // Dense cluster ids by decreasing size, and their sizes
+  arma::Col<I> clusterMembers;           // Sites of each cluster, indexed by clusterOffsets
+  arma::Col<uint64_t> clusterOffsets;
+  arma::Mat<T> latticeCoords, analysis, sweep;
+  arma::Mat<T> sizeDistribution, clusterRadii; // (size, count) and (size, radius of gyration)
+  arma::Cube<T> walksCoords;
+  uint64_t wrapping[2];
+  uint64_t largestMass;
+
+private:
+  uint64_t gridSize, latticeType;
+  double threshold;
+  uint64_t walkType, nWalks, nSteps;
+  double beta, tau0, noise;
+  int64_t randomSeed, nJobs;
+  uint64_t siteOrder, gridBits;
+  bool coordsRestored;
+  bool cellsTracked; // Whether parentCells is allocated and valid, which PercolateParallel does not maintain
+  uint64_t percolationType; // 0 : site percolation, 1 : bond percolation
+  uint64_t occupancy;       // 0 : fixed number of sites, 1 : Bernoulli
+
+  uint64_t N, nItems, simLength; // nItems is the number of sites or bonds
+  uint64_t nOccupied, largestCluster, nClusters;
+  double sumSquares;
+  I EMPTY;
+  uint8_t neighbourCount;
+
+  const double sqrt3 = 1.7320508075688772;
+  const double sqrt3o2 = 0.8660254037844386;
+
+  arma::Col<I> occupation;
+  static constexpr uint64_t permBits = 8;                  // log2 of permBlocks
+  static constexpr uint64_t permBlocks = 1ULL << permBits; // Blocks and buckets of the shuffle in Permute
+  static constexpr uint64_t walkBatch = 16;                // Walkers advanced together by each thread
+  uint64_t permSeed, nPermuted; // nPermuted is the shuffled prefix of occupation
+  std::vector<uint64_t> bucketStarts;
+  pcg64 bucketRNG; // Generator of the partly shuffled bucket
+  uint64_t startBegin, startCount; // Range of clusterMembers to start the walks from
+  // Unit cells from each site to its parent, exact in int16_t below 2^30
+  // sites, which the constructor enforces for 32-bit indices
+  typedef typename std::conditional<(sizeof(I) < 8), int16_t, int32_t>::type C;
+  arma::Mat<C> parentCells;
+  arma::Mat<I> nn;
+  arma::Mat<uint8_t> nnCells;
+  arma::Col<uint64_t> occupied;
+  arma::Col<uint8_t> neighbourMasks;
+  uint8_t stepCount[16], stepSlot[16][4];
+  arma::Col<T> unitCell, eaMSD, eataMSD, ergodicity;
+  arma::Mat<T> eaMSDall, eataMSDall, taMSD;
+
+  pcg64 RNG;
+  std::chrono::high_resolution_clock::time_point t0, t1;
+
+  inline uint64_t OccupiedCount(const double p) const
+  {
+    // Number of sites or bonds occupied by Percolate at threshold p
+    return (p * nItems - 1 > 0) ? static_cast<uint64_t>(std::ceil(p * nItems - 1)) : 0;
+  };
+
+  void ShuffleBuckets(const uint64_t m)
+  {
+    // Fisher-Yates shuffle of the buckets covering the first m entries,
+    // saving the generator of the last one to continue it later
+    const uint64_t nBlocks = permBlocks;
+    const uint64_t target = std::min(m, nItems);
+
+    if (occupancy == 1 || target <= nPermuted)
+    {
+      return;
+    }
+
+    const uint64_t c0 = std::upper_bound(bucketStarts.begin(), bucketStarts.end(), nPermuted) - bucketStarts.begin() - 1;
+    const uint64_t c1 = std::upper_bound(bucketStarts.begin(), bucketStarts.end(), target - 1) - bucketStarts.begin() - 1;
+    std::vector<pcg64> bucketRNGs(c1 - c0 + 1);
+
+    auto &&shuffle = [&](uint64_t k) {
+      const uint64_t c = c0 + k;
+      const uint64_t first = bucketStarts[c];
+      const uint64_t n = bucketStarts[c + 1] - first;
+      const uint64_t from = std::max(nPermuted, first) - first;
+      const uint64_t to = std::min(target, first + n) - first;
+      I t_;
+      uint64_t j;
+
+      pcg64 &rng = bucketRNGs[k];
+      rng = (from > 0) ? bucketRNG : pcg64(permSeed, nBlocks + c);
+
+      for (uint64_t i = from; i < to; i++)
+      {
+        j = i + BoundedRand(rng, n - i);
+        t_ = occupation(first + i);
+        occupation(first + i) = occupation(first + j);
+        occupation(first + j) = t_;
+      }
+    };
+    parallel(shuffle, static_cast<uint64_t>(0), c1 - c0 + 1, nJobs);
+
+    bucketRNG = bucketRNGs.back();
+    nPermuted = target;
+  };
+
+  uint64_t OccupyBernoulli()
+  {
+    // Occupy each site with probability threshold, one pcg stream per
+    // block of sites. Returns the number of occupied sites
+    const uint64_t nBlocks = permBlocks;
+    const uint64_t blockSize = (N + nBlocks - 1) / nBlocks;
+    const uint64_t seed = RNG();
+    const bool allOccupied = (threshold >= 1.0);
+    const uint64_t cutoff = (threshold > 0.0 && !allOccupied) ? static_cast<uint64_t>(std::ldexp(threshold, 64)) : 0;
+    std::vector<uint64_t> blockOccupied(nBlocks, 0);
+
+    auto &&occupy = [&](uint64_t b) {
+      pcg64 blockRNG(seed, b);
+      const uint64_t last = std::min(N, (b + 1) * blockSize);
+      for (uint64_t k = b * blockSize; k < last; k++)
+      {
+        if (allOccupied || blockRNG() < cutoff)
+        {
+          lattice(SiteIndex(k / gridSize, k % gridSize)) = -1;
+          blockOccupied[b]++;
+        }
+      }
+    };
+    parallel(occupy, static_cast<uint64_t>(0), nBlocks, nJobs);
+
+    uint64_t nOcc = 0;
+    for (size_t b = 0; b < nBlocks; b++)
+    {
+      nOcc += blockOccupied[b];
+    }
+    return nOcc;
+  };
+
+  void PercolateBernoulli()
+  {
+    // Sequential labelling of Bernoulli occupation, merging each edge once
+    I buffer[4];
+    uint8_t cellBuffer[4];
+    int32_t dx1, dy1;
+
+    ResetPercolation();
+    nOccupied = OccupyBernoulli();
+    nClusters = nOccupied;
+    sumSquares = nOccupied;
+    largestCluster = (nOccupied > 0) ? 1 : 0;
+
+    for (uint64_t i = 0; i < N; i++)
+    {
+      if (lattice(i) == EMPTY)
+      {
+        continue;
+      }
+
+      const uint8_t *cells;
+      const I *neighbours = NeighboursAndCells(i, buffer, cellBuffer, cells);
+      I r1 = FindRoot(static_cast<I>(i), dx1, dy1);
+      for (size_t j = 0; j < neighbourCount; j++)
+      {
+        if (static_cast<uint64_t>(neighbours[j]) > i && lattice(neighbours[j]) != EMPTY)
+        {
+          Merge(r1, dx1, dy1, neighbours[j], cells[j]);
+        }
+      }
+    }
+  };
+
+  void PackOccupancy()
+  {
+    // Pack the occupied sites into a 1-bit-per-site plane, so the random
+    // walks never need to touch the union-find array
+    occupied.set_size((N + 63) / 64);
+
+    auto &&func = [&](uint64_t w) {
+      uint64_t word = 0;
+      uint64_t last = std::min(N, 64 * (w + 1));
+      for (uint64_t i = 64 * w; i < last; i++)
+      {
+        word |= static_cast<uint64_t>(lattice(i) != EMPTY) << (i & 63);
+      }
+      occupied(w) = word;
+    };
+
+    parallel(func, static_cast<uint64_t>(0), static_cast<uint64_t>(occupied.n_elem), nJobs);
+
+    // Occupied neighbours of each site as a 4-bit mask, two sites per byte
+    neighbourMasks.set_size((N + 1) / 2);
+
+    auto &&maskFunc = [&](uint64_t b) {
+      I buffer[4];
+      uint8_t masks = 0;
+      uint64_t last = std::min(N, 2 * (b + 1));
+      for (uint64_t i = 2 * b; i < last; i++)
+      {
+        const I *neighbours = Neighbours(i, buffer);
+        uint8_t mask = 0;
+        for (uint8_t k = 0; k < neighbourCount; k++)
+        {
+          mask |= static_cast<uint8_t>(IsOccupied(neighbours[k])) << k;
+        }
+        masks |= mask << (4 * (i & 1));
+      }
+      neighbourMasks(b) = masks;
+    };
+
+    if (percolationType == 1) // In bond percolation, the walks can only follow occupied bonds
+    {
+      neighbourMasks.zeros();
+
+      I buffer[4];
+      uint8_t cellBuffer[4];
+      const uint64_t nOcc = OccupiedCount(threshold);
+      for (uint64_t k = 0; k < nOcc; k++)
+      {
+        const I i = occupation(k) / neighbourCount;
+        const uint8_t j = occupation(k) % neighbourCount;
+        const uint8_t *cells;
+        const I s2 = NeighboursAndCells(i, buffer, cellBuffer, cells)[j];
+        const uint8_t cell = cells[j];
+        neighbourMasks(i >> 1) |= (1 << j) << (4 * (i & 1));
+        neighbourMasks(s2 >> 1) |= (1 << ReverseSlot(s2, i, cell)) << (4 * (s2 & 1));
+      }
+    }
+    else
+    {
+      parallel(maskFunc, static_cast<uint64_t>(0), static_cast<uint64_t>(neighbourMasks.n_elem), nJobs);
+    }
+  };
+
+  void ResetPercolation(const bool withCells = true)
+  {
+    // The unit-cell displacements are only stored while they are
+    // tracked, PercolateParallel leaves them to UnwrapClusters
+    if (withCells)
+    {
+      parentCells.zeros(2, N);
+    }
+    else
+    {
+      parentCells.reset();
+    }
+    cellsTracked = withCells;
+    nOccupied = 0;
+    wrapping[0] = wrapping[1] = 0;
+
+    if (percolationType == 1) // Every site starts as a cluster of its own
+    {
+      lattice.fill(-1);
+      largestCluster = (N > 0) ? 1 : 0;
+      nClusters = N;
+      sumSquares = N;
+    }
+    else
+    {
+      lattice.fill(EMPTY);
+      largestCluster = 0;
+      nClusters = 0;
+      sumSquares = 0.0;
+    }
+  };
+
+  void BuildBonds()
+  {
+    // List each bond once, in column-major order
+    I buffer[4];
+    uint64_t col, row, nBonds = 0;
+
+    for (uint8_t pass = 0; pass < 2; pass++) // Count the bonds, then list them
+    {
+      if (pass == 1)
+      {
+        occupation.set_size(nBonds);
+        nBonds = 0;
+      }
+      for (uint64_t k = 0; k < N; k++)
+      {
+        const uint64_t i = SiteIndex(k / gridSize, k % gridSize);
+        const I *neighbours = Neighbours(i, buffer);
+        for (uint8_t j = 0; j < neighbourCount; j++)
+        {
+          SiteColRow(neighbours[j], col, row);
+          if (k < col * gridSize + row)
+          {
+            if (pass == 1)
+            {
+              occupation(nBonds) = static_cast<I>(i * neighbourCount + j);
+            }
+            nBonds++;
+          }
+        }
+      }
+    }
+  };
+
+  inline uint8_t ReverseSlot(const I s2, const I s1, const uint8_t cell)
+  {
+    // Slot of the bond s1 -> s2 as seen from s2, matching the unit-cell
+    // displacement so that parallel bonds on tiny lattices are distinct
+    I buffer[4];
+    uint8_t cellBuffer[4];
+    const uint8_t *cells;
+    const I *neighbours = NeighboursAndCells(s2, buffer, cellBuffer, cells);
+    const uint8_t reverse = CellCode(-CellX(cell), -CellY(cell));
+    for (uint8_t k = 0; k < neighbourCount; k++)
+    {
+      if (neighbours[k] == s1 && cells[k] == reverse)
+      {
+        return k;
+      }
+    }
+    return 0;
+  };
+
+  void AddItems(const uint64_t nOcc)
+  {
+    // Add the next sites (or bonds) in occupation order until nOcc
+    // have been added
+    I buffer[4];
+    uint8_t cellBuffer[4];
+
+    ShuffleBuckets(nOcc);
+    while (nOccupied < nOcc)
+    {
+      AddItem(occupation[nOccupied], buffer, cellBuffer);
+    }
+  };
+
+  inline void AddItem(const I item, I *buffer, uint8_t *cellBuffer)
+  {
+    if (percolationType == 1)
+    {
+      AddBond(item, buffer, cellBuffer);
+    }
+    else
+    {
+      AddSite(item, buffer, cellBuffer);
+    }
+  };
+
+  inline void AddBond(const I bond, I *buffer, uint8_t *cellBuffer)
+  {
+    // Occupy a bond and merge the clusters at its two ends
+    const I s1 = bond / neighbourCount;
+    const uint8_t j = bond % neighbourCount;
+    int32_t dx1, dy1;
+    const uint8_t *cells;
+    const I s2 = NeighboursAndCells(s1, buffer, cellBuffer, cells)[j];
+
+    nOccupied++;
+    I r1 = FindRoot(s1, dx1, dy1);
+    Merge(r1, dx1, dy1, s2, cells[j]);
+  };
+
+  inline void AddSite(const I s1, I *buffer, uint8_t *cellBuffer)
+  {
+    // Occupy site s1 and merge it with its occupied neighbours, tracking
+    // the image of each root to detect wrapping [New2001]
+    I s2, r1;
+    int32_t dx1 = 0, dy1 = 0;
+    const I *neighbours;
+    const uint8_t *cells;
+
+    r1 = s1;
+    lattice(s1) = -1;
+    nOccupied++;
+    nClusters++;
+    sumSquares += 1.0;
+    largestCluster = std::max(largestCluster, static_cast<uint64_t>(1));
+
+    neighbours = NeighboursAndCells(s1, buffer, cellBuffer, cells);
+    for (size_t j = 0; j < neighbourCount; j++)
+    {
+      s2 = neighbours[j];
+      if (lattice(s2) != EMPTY)
+      {
+        Merge(r1, dx1, dy1, s2, cells[j]);
+      }
+    }
+  };
+
+  inline void Merge(I &r1, int32_t &dx1, int32_t &dy1, const I s2, const uint8_t cell)
+  {
+    // Merge the cluster of s2 into that of r1, updating r1 and (dx1, dy1)
+    int32_t dx2, dy2, dx, dy;
+    const I r2 = FindRoot(s2, dx2, dy2);
+
+    // Image of r2 relative to the image of r1, across the edge
+    dx = dx1 + CellX(cell) - dx2;
+    dy = dy1 + CellY(cell) - dy2;
+
+    if (r2 == r1)
+    {
+      if (dx != 0 && wrapping[0] == 0)
+      {
+        wrapping[0] = nOccupied;
+      }
+      if (dy != 0 && wrapping[1] == 0)
+      {
+        wrapping[1] = nOccupied;
+      }
+    }
+    else
+    {
+      nClusters--;
+      sumSquares += 2.0 * static_cast<double>(lattice(r1)) * static_cast<double>(lattice(r2));
+
+      if (lattice(r1) > lattice(r2))
+      {
+        lattice(r2) += lattice(r1);
+        lattice(r1) = r2;
+        parentCells(0, r1) = -dx;
+        parentCells(1, r1) = -dy;
+        dx1 -= dx;
+        dy1 -= dy;
+        r1 = r2;
+      }
+      else
+      {
+        lattice(r1) += lattice(r2);
+        lattice(r2) = r1;
+        parentCells(0, r2) = dx;
+        parentCells(1, r2) = dy;
+      }
+      if (static_cast<uint64_t>(-lattice(r1)) > largestCluster)
+      {
+        largestCluster = -lattice(r1);
+      }
+    }
+  };
+
+  inline I FindRoot(const I i, int32_t &dx, int32_t &dy)
+  {
+    // Root of site i in the percolation forest, and the displacement
+    // of site i from the root in unit cells
+    return FindRootIn<true>(lattice, i, dx, dy);
+  };
+
+  template <bool withCells>
+  inline I FindRootIn(arma::Col<I> &parent, const I i, int32_t &dx, int32_t &dy)
+  {
+    // Iterative find, with compression chosen at compile time:
+    //  - CTRW_FIND_HALVING or CTRW_FIND_SPLITTING : path halving or splitting
+    //  - otherwise : full path compression
+    I x = i, p;
+    dx = dy = 0;
+#if defined(CTRW_FIND_HALVING)
+    while (parent(x) >= 0)
+    {
+      p = parent(x);
+      if (parent(p) >= 0)
+      {
+        if (withCells)
+        {
+          parentCells(0, x) += parentCells(0, p);
+          parentCells(1, x) += parentCells(1, p);
+        }
+        parent(x) = parent(p);
+      }
+      if (withCells)
+      {
+        dx += parentCells(0, x);
+        dy += parentCells(1, x);
+      }
+      x = parent(x);
+    }
+    return x;
+#elif defined(CTRW_FIND_SPLITTING)
+    while (parent(x) >= 0)
+    {
+      p = parent(x);
+      if (withCells)
+      {
+        dx += parentCells(0, x);
+        dy += parentCells(1, x);
+      }
+      if (parent(p) >= 0)
+      {
+        if (withCells)
+        {
+          parentCells(0, x) += parentCells(0, p);
+          parentCells(1, x) += parentCells(1, p);
+        }
+        parent(x) = parent(p);
+      }
+      x = p;
+    }
+    return x;
+#else
+    I root = i;
+    while (parent(root) >= 0)
+    {
+      if (withCells)
+      {
+        dx += parentCells(0, root);
+        dy += parentCells(1, root);
+      }
+      root = parent(root);
+    }
+
+    int32_t restX = dx, restY = dy, cellX, cellY;
+    while (x != root)
+    {
+      p = parent(x);
+      parent(x) = root;
+      if (withCells)
+      {
+        cellX = parentCells(0, x);
+        cellY = parentCells(1, x);
+        parentCells(0, x) = restX;
+        parentCells(1, x) = restY;
+        restX -= cellX;
+        restY -= cellY;
+      }
+      x = p;
+    }
+    return root;
+#endif
+  };
+
+  static inline uint64_t LinkPriority(uint64_t x)
+  {
+    // Bijective mix of the site index (splitmix64 finaliser), giving
+    // distinct pseudo-random priorities for linking roots
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+    return x ^ (x >> 31);
+  };
+
+  static inline I FindRootAtomic(std::atomic<I> *parent, I i)
+  {
+    // Path splitting: point each visited site at its grandparent
+    I p, g, expected;
+    while ((p = parent[i].load(std::memory_order_acquire)) != i)
+    {
+      g = parent[p].load(std::memory_order_acquire);
+      if (g != p)
+      {
+        expected = p;
+        parent[i].compare_exchange_weak(expected, g, std::memory_order_acq_rel);
+      }
+      i = p;
+    }
+    return i;
+  };
+
+  static inline void UniteAtomic(std::atomic<I> *parent, I a, I b)
+  {
+    // Roots only ever link below roots of higher priority, so no cycles
+    // form, and a failed CAS means another thread linked the root first
+    while (true)
+    {
+      a = FindRootAtomic(parent, a);
+      b = FindRootAtomic(parent, b);
+      if (a == b)
+      {
+        return;
+      }
+      if (LinkPriority(a) < LinkPriority(b))
+      {
+        std::swap(a, b);
+      }
+      I expected = b;
+      if (parent[b].compare_exchange_strong(expected, a, std::memory_order_acq_rel))
+      {
+        return;
+      }
+    }
+  };
+
+  inline I FindRootReadOnly(I i, int32_t &dx, int32_t &dy) const
+  {
+    // Root of site i and the displacement of i from it in unit cells,
+    // without compressing the path, so it can be called concurrently
+    dx = dy = 0;
+    while (lattice(i) >= 0)
+    {
+      dx += parentCells(0, i);
+      dy += parentCells(1, i);
+      i = lattice(i);
+    }
+    return i;
+  };
+
+  inline I FindRootReadOnly(I i) const
+  {
+    // Root of site i, without reading parentCells, which is not
+    // allocated after PercolateParallel
+    while (lattice(i) >= 0)
+    {
+      i = lattice(i);
+    }
+    return i;
+  };
+
+  uint64_t RankClusters(arma::Col<I> &rank)
+  {
+    // Number the clusters by decreasing size, ties by first site in
+    // column-major order. On return, rank holds each number at its root
+    const uint64_t nBlocks = 256;
+    const uint64_t blockSize = (N + nBlocks - 1) / nBlocks;
+    std::unique_ptr<std::atomic<I>[]> first(new std::atomic<I>[N]);
+
+    auto &&init = [&](uint64_t i) { first[i].store(static_cast<I>(N), std::memory_order_relaxed); };
+    parallel(init, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+
+    // Lowest column-major index of each cluster, only updated when the
+    // root changes along a block
+    auto &&firstSites = [&](uint64_t b) {
+      const uint64_t last = std::min(N, (b + 1) * blockSize);
+      I current = -1;
+      for (uint64_t k = b * blockSize; k < last; k++)
+      {
+        const uint64_t i = SiteIndex(k / gridSize, k % gridSize);
+        if (lattice(i) == EMPTY)
+        {
+          continue;
+        }
+
+        const I root = FindRootReadOnly(static_cast<I>(i));
+        if (root != current)
+        {
+          current = root;
+          I prev = first[root].load(std::memory_order_relaxed);
+          while (static_cast<I>(k) < prev &&
+                 !first[root].compare_exchange_weak(prev, static_cast<I>(k), std::memory_order_relaxed))
+          {
+          }
+        }
+      }
+    };
+    parallel(firstSites, static_cast<uint64_t>(0), nBlocks, nJobs);
+
+    // Collect the roots, counting over fixed blocks, and sort them
+    std::vector<uint64_t> blockRoots(nBlocks + 1, 0);
+
+    auto &&countRoots = [&](uint64_t b) {
+      const uint64_t last = std::min(N, (b + 1) * blockSize);
+      for (uint64_t i = b * blockSize; i < last; i++)
+      {
+        blockRoots[b + 1] += (lattice(i) < 0 && lattice(i) != EMPTY);
+      }
+    };
+    parallel(countRoots, static_cast<uint64_t>(0), nBlocks, nJobs);
+
+    for (size_t b = 0; b < nBlocks; b++)
+    {
+      blockRoots[b + 1] += blockRoots[b];
+    }
+    const uint64_t K = blockRoots[nBlocks];
+    std::vector<I> roots(K);
+
+    auto &&collectRoots = [&](uint64_t b) {
+      const uint64_t last = std::min(N, (b + 1) * blockSize);
+      uint64_t k = blockRoots[b];
+      for (uint64_t i = b * blockSize; i < last; i++)
+      {
+        if (lattice(i) < 0 && lattice(i) != EMPTY)
+        {
+          roots[k++] = static_cast<I>(i);
+        }
+      }
+    };
+    parallel(collectRoots, static_cast<uint64_t>(0), nBlocks, nJobs);
+
+    std::sort(roots.begin(), roots.end(), [&](const I r1, const I r2) {
+      return (lattice(r1) != lattice(r2)) ? lattice(r1) < lattice(r2)
+                                          : first[r1].load(std::memory_order_relaxed) < first[r2].load(std::memory_order_relaxed);
+    });
+
+    rank.set_size(N);
+    auto &&func = [&](uint64_t k) { rank(roots[k]) = static_cast<I>(k); };
+    parallel(func, static_cast<uint64_t>(0), K, nJobs);
+
+    return K;
+  };
+
+  inline void LatticeUnits(const uint64_t i, int64_t &x, int64_t &y) const
+  {
+    // Position of site i in integer lattice units
+    uint64_t col, row;
+    SiteColRow(i, col, row);
+    if (latticeType == 1)
+    {
+      const int64_t xOffset[4] = {0, 1, 3, 4}, yOffset[4] = {1, 0, 0, 1};
+      x = 6 * static_cast<int64_t>(col / 4) + xOffset[col % 4];
+      y = 2 * static_cast<int64_t>(gridSize - row - 1) + yOffset[col % 4];
+    }
+    else
+    {
+      x = col;
+      y = row;
+    }
+  };
+
+  void UnwrapClusters()
+  {
+    // PercolateParallel does not track unit cells, so recover them with
+    // a breadth-first search of each cluster from its root
+    if (cellsTracked)
+    {
+      return;
+    }
+
+    PackOccupancy();
+    parentCells.set_size(2, N);
+
+    I buffer[4];
+    uint8_t cellBuffer[4];
+    std::vector<bool> visited(N, false);
+    std::vector<I> queue;
+
+    for (uint64_t r = 0; r < N; r++)
+    {
+      if (lattice(r) >= 0 || lattice(r) == EMPTY)
+      {
+        continue;
+      }
+
+      visited[r] = true;
+      parentCells(0, r) = parentCells(1, r) = 0;
+      queue.assign(1, static_cast<I>(r));
+
+      for (size_t head = 0; head < queue.size(); head++)
+      {
+        const I s1 = queue[head];
+        const uint8_t mask = NeighbourMask(s1);
+        const uint8_t *cells;
+        const I *neighbours = NeighboursAndCells(s1, buffer, cellBuffer, cells);
+        for (uint8_t j = 0; j < neighbourCount; j++)
+        {
+          const I s2 = neighbours[j];
+          if (((mask >> j) & 1) && !visited[s2])
+          {
+            visited[s2] = true;
+            lattice(s2) = static_cast<I>(r);
+            parentCells(0, s2) = parentCells(0, s1) + CellX(cells[j]);
+            parentCells(1, s2) = parentCells(1, s1) + CellY(cells[j]);
+            queue.push_back(s2);
+          }
+        }
+      }
+    }
+
+    cellsTracked = true;
+  };
+
+  inline I GroupRoot(const I i)
+  {
+    int32_t dx, dy;
+    return FindRootIn<false>(clusters, i, dx, dy);
+  };
+
+  void PossibleStartPoints()
+  {
+    // Set up selection of random start point from the cluster index
+    //  - walkType = 1 : on largest cluster, or
+    //  - walkType = 0 : on ALL clusters
+    startBegin = 0;
+    startCount = (walkType == 1 && clusterSizes.n_elem > 0) ? clusterOffsets(1) : clusterOffsets(clusterSizes.n_elem);
+    if (startCount == 0 && nWalks > 0)
+    {
+      throw std::invalid_argument("No occupied sites to start the walks from");
+    }
+  };
+
+  inline bool IsOccupied(const uint64_t i) const
+  {
+    return (occupied(i >> 6) >> (i & 63)) & 1;
+  };
+
+  inline uint8_t NeighbourMask(const uint64_t i) const
+  {
+    return (neighbourMasks(i >> 1) >> (4 * (i & 1))) & 15;
+  };
+
+  inline void PrefetchSite(const uint64_t i) const
+  {
+    // Prefetch what the next step from site i reads
+    __builtin_prefetch(neighbourMasks.memptr() + (i >> 1));
+    __builtin_prefetch(latticeCoords.colptr(i));
+#ifndef CTRW_IMPLICIT_NEIGHBOURS
+    __builtin_prefetch(nn.colptr(i));
+    __builtin_prefetch(nnCells.colptr(i));
+#endif
+  };
+
+  inline uint64_t SiteIndex(const uint64_t col, const uint64_t row) const
+  {
+    // Storage index of the site in column col and row row
+    if (siteOrder == 1)
+    {
+      return ((col >> gridBits) << (2 * gridBits)) |
+             (MortonSpread(col & (gridSize - 1)) << 1) | MortonSpread(row);
+    }
+    return col * gridSize + row;
+  };
+
+  inline uint64_t ColumnMajorIndex(const uint64_t i) const
+  {
+    uint64_t col, row;
+    SiteColRow(i, col, row);
+    return col * gridSize + row;
+  };
+
+  inline void SiteColRow(const uint64_t i, uint64_t &col, uint64_t &row) const
+  {
+    // Inverse of SiteIndex
+    if (siteOrder == 1)
+    {
+      const uint64_t block = i >> (2 * gridBits);
+      const uint64_t code = i - (block << (2 * gridBits));
+      col = (block << gridBits) | MortonCompact(code >> 1);
+      row = MortonCompact(code);
+      return;
+    }
+    col = i / gridSize;
+    row = i % gridSize;
+  };
+
+  inline const I *Neighbours(const uint64_t i, I *buffer) const
+  {
+    // Neighbours of site i, from nn or computed into buffer
+#ifdef CTRW_IMPLICIT_NEIGHBOURS
+    if (latticeType == 1)
+    {
+      HoneycombStencil(i, buffer, nullptr);
+    }
+    else
+    {
+      SquareStencil(i, buffer, nullptr);
+    }
+    return buffer;
+#else
+    (void)buffer;
+    return nn.colptr(i);
+#endif
+  };
+
+  inline const I *NeighboursAndCells(const uint64_t i, I *buffer, uint8_t *cellBuffer, const uint8_t *&cells) const
+  {
+    // As Neighbours, also pointing cells at the unit-cell displacements
+#ifdef CTRW_IMPLICIT_NEIGHBOURS
+    if (latticeType == 1)
+    {
+      HoneycombStencil(i, buffer, cellBuffer);
+    }
+    else
+    {
+      SquareStencil(i, buffer, cellBuffer);
+    }
+    cells = cellBuffer;
+    return buffer;
+#else
+    (void)buffer;
+    (void)cellBuffer;
+    cells = nnCells.colptr(i);
+    return nn.colptr(i);
+#endif
+  };
+
+  static inline uint8_t CellCode(const int dx, const int dy)
+  {
+    return static_cast<uint8_t>((dx + 1) + 3 * (dy + 1));
+  };
+
+  static inline int CellX(const uint8_t code) { return code % 3 - 1; };
+
+  static inline int CellY(const uint8_t code) { return code / 3 - 1; };
+
+  void BoundariesHoneycomb()
+  {
+    // Honeycomb lattice nearest neighbours with periodic boundary conditions
+    auto &&func = [&](uint64_t i) { HoneycombStencil(i, nn.colptr(i), nnCells.colptr(i)); };
+    parallel(func, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+  };
+
+  void BoundariesSquare()
+  {
+    // Square lattice nearest neighbours with periodic boundary conditions
+    auto &&func = [&](uint64_t i) { SquareStencil(i, nn.colptr(i), nnCells.colptr(i)); };
+    parallel(func, static_cast<uint64_t>(0), static_cast<uint64_t>(N), nJobs);
+  };
+
+  inline void HoneycombStencil(const uint64_t i, I *neighbours, uint8_t *cells) const
+  {
+    // Honeycomb lattice nearest neighbours in O(1) from (column, row)
+    const uint64_t nCols = 4 * gridSize;
+    uint64_t col, row;
+    SiteColRow(i, col, row);
+
+    const uint64_t colL = ((col == 0) ? nCols : col) - 1; // Periodic wrap in x
+    const uint64_t colR = (col + 1 == nCols) ? 0 : col + 1;
+    const uint64_t rowU = ((row == 0) ? gridSize : row) - 1; // Periodic wrap in y
+    const uint64_t rowD = (row + 1 == gridSize) ? 0 : row + 1;
+
+    const int dxL = (col == 0) ? -1 : 0; // Unit cells crossed by each wrap
+    const int dxR = (col + 1 == nCols) ? 1 : 0;
+    const int dyU = (row == 0) ? 1 : 0;
+    const int dyD = (row + 1 == gridSize) ? -1 : 0;
+
+    uint8_t k = 0;
+    auto &&add = [&](const uint64_t c, const uint64_t r, const int dx, const int dy) {
+      neighbours[k] = SiteIndex(c, r);
+      if (cells)
+      {
+        cells[k] = CellCode(dx, dy);
+      }
+      k++;
+    };
+
+    switch (col % 4)
     {
-      if (i == 0) // First site
+    case 0:
+    default:
+      if (col != 0)
+      {
+        add(colL, row, dxL, 0);
+      }
+      if (row == 0)
+      {
+        add(colR, row, dxR, 0);
+        add(colR, rowU, dxR, dyU);
+      }
+      else
+      {
+        add(colR, rowU, dxR, dyU);
+        add(colR, row, dxR, 0);
+      }
+      if (col == 0) // First column lists the wrapped neighbour last
+      {
+        add(colL, row, dxL, 0);
+      }
+      break;
+    case 1:
+      add(colL, row, dxL, 0);
+      if (row + 1 == gridSize)
       {
-        nn(0, i) = i + gridSize;
-        nn(1, i) = i + 2 * gridSize - 1;
-        nn(2, i) = i + N - gridSize;
+        add(colR, row, dxR, 0);
+        add(colL, rowD, dxL, dyD);
       }
-      else if (i == N - gridSize) // Top right-hand corner
+      else
       {
-        nn(0, i) = i - 1;
-        nn(1, i) = i - gridSize;
-        nn(2, i) = i - N + gridSize;
+        add(colL, rowD, dxL, dyD);
+        add(colR, row, dxR, 0);
       }
-      else if (i == N - gridSize - 1) // Bottom right-hand corner
+      break;
+    case 2:
+      add(colL, row, dxL, 0);
+      add(colR, row, dxR, 0);
+      add(colR, rowD, dxR, dyD);
+      break;
+    case 3:
+      add(colL, rowU, dxL, dyU);
+      add(colL, row, dxL, 0);
+      add(colR, row, dxR, 0);
+      break;
+    }
+  };
+
+  inline void SquareStencil(const uint64_t i, I *neighbours, uint8_t *cells) const
+  {
+    // Neighbours are ordered (row + 1), (row - 1), (col + 1), (col - 1)
+    uint64_t col, row;
+    SiteColRow(i, col, row);
+
+    neighbours[0] = SiteIndex(col, (row + 1 == gridSize) ? 0 : row + 1);
+    neighbours[1] = SiteIndex(col, ((row == 0) ? gridSize : row) - 1);
+    neighbours[2] = SiteIndex((col + 1 == gridSize) ? 0 : col + 1, row);
+    neighbours[3] = SiteIndex(((col == 0) ? gridSize : col) - 1, row);
+
+    if (cells)
+    {
+      cells[0] = CellCode(0, (row + 1 == gridSize) ? 1 : 0);
+      cells[1] = CellCode(0, (row == 0) ? -1 : 0);
+      cells[2] = CellCode((col + 1 == gridSize) ? 1 : 0, 0);
+      cells[3] = CellCode((col == 0) ? -1 : 0, 0);
+    }
+  };
+};
+
+// Percolation state that can be advanced to higher thresholds without
+// repeating FindNeighbours, Permute or earlier unions
+template <typename T, typename I = int64_t>
+class PercolationHandle
+{
+public:
+  PercolationHandle(
+      const uint64_t gridSize,
+      const uint64_t latticeType,
+      const double threshold,
+      const int64_t randomSeed,
+      const int64_t nJobs,
+      const uint64_t siteOrder,
+      const uint64_t labelling,
+      const uint64_t percolationType,
+      const uint64_t occupancy)
+  {
+    sim = new CTRWfractal<T, I>(
+        gridSize,
+        latticeType,
+        threshold,
+        0,
+        0,
+        0,
+        0.0,
+        1.0,
+        0.0,
+        randomSeed,
+        nJobs,
+        siteOrder,
+        percolationType,
+        occupancy);
+
+    sim->FindNeighbours(); // Identify neighbouring sites
+    sim->Permute();        // Randomize the order in which the sites are occupied
+
+    if (labelling == 1)
+    {
+      sim->PercolateParallel(); // Label the clusters with nJobs threads
+    }
+    else
+    {
+      sim->Percolate(); // Run the percolation algorithm
+    }
+
+    sim->BuildLattice(); // Build the lattice coordinates
+  };
+
+  ~PercolationHandle()
+  {
+    delete sim;
+  };
+
+  void Advance(const double threshold)
+  {
+    sim->Advance(threshold); // Add the sites between the two thresholds
+    indexed = false;
+  };
+
+  void Clusters(arma::Col<int64_t> &clusters, uint64_t &wrappingX, uint64_t &wrappingY)
+  {
+    sim->GroupClusters();    // Group clusters by root
+    sim->RestoreSiteOrder(); // Return sites in column-major order
+
+    clusters = arma::conv_to<arma::Col<int64_t>>::from(sim->clusters);
+    wrappingX = sim->wrapping[0];
+    wrappingY = sim->wrapping[1];
+  };
+
+  void Lattice(arma::Mat<T> &lattice)
+  {
+    sim->RestoreSiteOrder(); // Return sites in column-major order
+
+    lattice = sim->latticeCoords;
+  };
+
+  void Labels(arma::Col<int64_t> &labels, arma::Col<int64_t> &labelSizes)
+  {
+    sim->RelabelClusters(); // Dense cluster ids by decreasing size
+
+    labels = arma::conv_to<arma::Col<int64_t>>::from(sim->clusterIds);
+    labelSizes = arma::conv_to<arma::Col<int64_t>>::from(sim->clusterSizes);
+  };
+
+  void ClusterSites(const uint64_t label, arma::Col<int64_t> &sites)
+  {
+    // Column-major indices of the sites in cluster label, from the
+    // cluster index, which is rebuilt after each Advance
+    if (!indexed)
+    {
+      sim->RelabelClusters();   // Dense cluster ids by decreasing size
+      sim->BuildClusterIndex(); // Index the sites of each cluster
+      indexed = true;
+    }
+
+    sim->ClusterSites(label, sites);
+  };
+
+  void Statistics(arma::Mat<T> &sizes, arma::Mat<T> &radii, uint64_t &largest)
+  {
+    sim->ClusterStatistics(); // Size histogram and radii of gyration
+
+    sizes = sim->sizeDistribution;
+    radii = sim->clusterRadii;
+    largest = sim->largestMass;
+  };
+
+private:
+  CTRWfractal<T, I> *sim;
+  bool indexed = false;
+};
+
+// Out-of-core Hoshen-Kopelman labelling of Bernoulli site percolation on
+// a periodic square lattice, holding O(gridSize) labels
+class HoshenKopelman
+{
+public:
+  HoshenKopelman(
+      const uint64_t gridSize,
+      const double threshold,
+      const int64_t randomSeed) : gridSize(gridSize),
+                                  threshold(threshold),
+                                  randomSeed(randomSeed)
+  {
+    if (randomSeed < 0) // Seed with external entropy from std::random_device
+    {
+      RNG.seed(pcg_extras::seed_seq_from<std::random_device>());
+    }
+    else
+    {
+      RNG.seed(randomSeed);
+    }
+  };
+
+  ~HoshenKopelman(){};
+
+  void Run()
+  {
+    PrintFixed(0, "Running strip percolation..");
+    t0 = GetTime();
+
+    // A site is occupied if a 64-bit draw falls below threshold * 2^64,
+    // drawn over blocks of sites with one pcg stream each, as in OccupyBernoulli
+    const bool allOccupied = (threshold >= 1.0);
+    const uint64_t cutoff = (threshold > 0.0 && !allOccupied) ? static_cast<uint64_t>(std::ldexp(threshold, 64)) : 0;
+    const uint64_t nBlocks = 256;
+    const uint64_t blockSize = (gridSize * gridSize + nBlocks - 1) / nBlocks;
+    const uint64_t seed = RNG();
+    pcg64 blockRNG;
+
+    first.assign(gridSize, NONE);
+    previous.assign(gridSize, NONE);
+    current.assign(gridSize, NONE);
+    parent.clear();
+    size.clear();
+    sizes.clear();
+    nOccupied = largestCluster = nClusters = 0;
+    sumSquares = 0.0;
+
+    for (uint64_t row = 0; row < gridSize; row++)
+    {
+      for (uint64_t col = 0; col < gridSize; col++)
       {
-        nn(0, i) = i - gridSize;
-        nn(1, i) = i + gridSize;
-        nn(2, i) = i + 1;
+        const uint64_t k = row * gridSize + col;
+        if (k % blockSize == 0)
+        {
+          blockRNG = pcg64(seed, k / blockSize);
+        }
+
+        current[col] = NONE;
+        if (!allOccupied && blockRNG() >= cutoff)
+        {
+          continue;
+        }
+
+        nOccupied++;
+        uint32_t label = NONE;
+        if (col > 0 && current[col - 1] != NONE)
+        {
+          label = FindRoot(current[col - 1]);
+        }
+        if (row > 0 && previous[col] != NONE)
+        {
+          label = (label == NONE) ? FindRoot(previous[col]) : Union(label, previous[col]);
+        }
+        if (label == NONE)
+        {
+          label = static_cast<uint32_t>(parent.size());
+          parent.push_back(label);
+          size.push_back(0);
+        }
+        size[label]++;
+        current[col] = label;
       }
-      else if (i < gridSize) // First column
+
+      if (gridSize > 1 && current[0] != NONE && current[gridSize - 1] != NONE)
       {
-        nn(0, i) = i + gridSize - 1;
-        nn(1, i) = i + gridSize;
-        nn(2, i) = i + N - gridSize;
+        Union(current[0], current[gridSize - 1]); // Periodic wrap along the row
       }
-      else if (i > (N - gridSize)) // Last column
+
+      if (row == 0)
       {
-        nn(0, i) = i - gridSize - 1;
-        nn(1, i) = i - gridSize;
-        nn(2, i) = i - N + gridSize;
+        first = current;
       }
-      else // Run through the rest of the tests
+
+      Compact();
+      std::swap(previous, current);
+    }
+
+    if (gridSize > 1) // Periodic wrap between the last and first rows
+    {
+      for (uint64_t col = 0; col < gridSize; col++)
       {
-        switch (currentCol)
+        if (previous[col] != NONE && first[col] != NONE)
         {
-        case 0:
-          if (arma::any(firstRow == i)) // First row
-          {
-            nn(0, i) = i - gridSize;
-            nn(1, i) = i + gridSize;
-            nn(2, i) = i + 2 * gridSize - 1;
-          }
-          else
-          {
-            nn(0, i) = i - gridSize;
-            nn(1, i) = i + gridSize - 1;
-            nn(2, i) = i + gridSize;
-          }
-          break;
-        case 1:
-          if (arma::any(lastRow == i)) // Last row
-          {
-            nn(0, i) = i - gridSize;
-            nn(1, i) = i + gridSize;
-            nn(2, i) = i - 2 * gridSize + 1;
-          }
-          else
-          {
-            nn(0, i) = i - gridSize;
-            nn(1, i) = i - gridSize + 1;
-            nn(2, i) = i + gridSize;
-          }
-          break;
-        case 2:
-          if (arma::any(lastRow == i)) // Last row
-          {
-            nn(0, i) = i - gridSize;
-            nn(1, i) = i + gridSize;
-            nn(2, i) = i + 1;
-          }
-          else
-          {
-            nn(0, i) = i - gridSize;
-            nn(1, i) = i + gridSize;
-            nn(2, i) = i + gridSize + 1;
-          }
-          break;
-        case 3:
-          if (arma::any(firstRow == i)) // First row
-          {
-            nn(0, i) = i - 1;
-            nn(1, i) = i - gridSize;
-            nn(2, i) = i + gridSize;
-          }
-          else
-          {
-            nn(0, i) = i - gridSize - 1;
-            nn(1, i) = i - gridSize;
-            nn(2, i) = i + gridSize;
-          }
-          break;
+          Union(previous[col], first[col]);
         }
       }
+    }
 
-      if ((i + 1) % gridSize == 0) // Update current column
+    for (uint32_t label = 0; label < parent.size(); label++) // Record the remaining clusters
+    {
+      if (parent[label] == label)
       {
-        count++;
-        currentCol = count % 4;
+        Record(size[label]);
       }
     }
+
+    t1 = GetTime();
+    PrintFixed(6, ElapsedSeconds(t0, t1), " s\n");
+  }
+
+  std::map<uint64_t, uint64_t> sizes; // Cluster size histogram
+  uint64_t nOccupied, largestCluster, nClusters;
+  double sumSquares;
+
+private:
+  uint64_t gridSize;
+  double threshold;
+  int64_t randomSeed;
+
+  const uint32_t NONE = 0xFFFFFFFF; // Empty site
+
+  std::vector<uint32_t> first, previous, current, parent, relabel;
+  std::vector<uint64_t> size;
+
+  pcg64 RNG;
+  std::chrono::high_resolution_clock::time_point t0, t1;
+
+  inline uint32_t FindRoot(uint32_t i)
+  {
+    while (parent[i] != i) // Path halving
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
   };
 
-  void BoundariesSquare()
+  inline uint32_t Union(uint32_t a, uint32_t b)
   {
-    // Square lattice nearest neighbours with periodic boundary conditions
-    for (size_t i = 0; i < N; i++)
+    // Weighted union of the clusters containing labels a and b,
+    // returning the new root
+    a = FindRoot(a);
+    b = FindRoot(b);
+    if (a == b)
+    {
+      return a;
+    }
+    if (size[a] < size[b])
     {
-      nn(0, i) = (i + 1) % N;
-      nn(1, i) = (i + N - 1) % N;
-      nn(2, i) = (i + gridSize) % N;
-      nn(3, i) = (i + N - gridSize) % N;
-      if (i % gridSize == 0)
+      std::swap(a, b);
+    }
+    parent[b] = a;
+    size[a] += size[b];
+    return a;
+  };
+
+  inline void Record(const uint64_t s)
+  {
+    sizes[s]++;
+    nClusters++;
+    largestCluster = std::max(largestCluster, s);
+    sumSquares += static_cast<double>(s) * static_cast<double>(s);
+  };
+
+  void Compact()
+  {
+    // Record the clusters that can no longer grow and renumber the
+    // live ones 0..K-1, so the label table stays O(gridSize)
+    const uint32_t nLabels = static_cast<uint32_t>(parent.size());
+    relabel.assign(nLabels, NONE);
+
+    std::vector<uint64_t> newSize;
+    auto &&live = [&](std::vector<uint32_t> &labels) {
+      for (auto &label : labels)
       {
-        nn(1, i) = i + gridSize - 1;
+        if (label != NONE)
+        {
+          const uint32_t root = FindRoot(label);
+          if (relabel[root] == NONE)
+          {
+            relabel[root] = static_cast<uint32_t>(newSize.size());
+            newSize.push_back(size[root]);
+          }
+          label = relabel[root];
+        }
       }
-      if ((i + 1) % gridSize == 0)
+    };
+    live(first);
+    live(current);
+
+    for (uint32_t label = 0; label < nLabels; label++)
+    {
+      if (parent[label] == label && relabel[label] == NONE)
       {
-        nn(0, i) = i - gridSize + 1;
+        Record(size[label]);
       }
     }
+
+    size.swap(newSize);
+    parent.resize(size.size());
+    for (uint32_t label = 0; label < parent.size(); label++)
+    {
+      parent[label] = label;
+    }
   };
 };
 
-template <typename T>
+template <typename T, typename I = int64_t>
 uint64_t CTRWwrapper(
     arma::Col<int64_t> &clusters,
     arma::Mat<T> &lattice,
     arma::Mat<T> &analysis,
     arma::Cube<T> &walks,
+    uint64_t &wrappingX,
+    uint64_t &wrappingY,
+    arma::Col<int64_t> &labels,
+    arma::Col<int64_t> &labelSizes,
     const uint64_t gridSize,
     const uint64_t latticeType,
     const double threshold,
@@ -783,9 +2382,13 @@ uint64_t CTRWwrapper(
     const double tau0,
     const double noise,
     const int64_t randomSeed,
-    const int64_t nJobs)
+    const int64_t nJobs,
+    const uint64_t siteOrder,
+    const uint64_t labelling,
+    const uint64_t percolationType,
+    const uint64_t occupancy)
 {
-  CTRWfractal<T> *sim = new CTRWfractal<T>(
+  std::unique_ptr<CTRWfractal<T, I>> sim(new CTRWfractal<T, I>(
       gridSize,
       latticeType,
       threshold,
@@ -796,26 +2399,45 @@ uint64_t CTRWwrapper(
       tau0,
       noise,
       randomSeed,
-      nJobs);
+      nJobs,
+      siteOrder,
+      percolationType,
+      occupancy));
 
   sim->FindNeighbours(); // Identify neighbouring sites
   sim->Permute();        // Randomize the order in which the sites are occupied
-  sim->Percolate();      // Run the percolation algorithm
-  sim->BuildLattice();   // Build the lattice coordinates
-  sim->GroupClusters();  // Group clusters by root
+  if (labelling == 1)
+  {
+    sim->PercolateParallel(); // Label the clusters with nJobs threads
+  }
+  else
+  {
+    sim->Percolate(); // Run the percolation algorithm
+  }
+  sim->BuildLattice();    // Build the lattice coordinates
+  sim->GroupClusters();   // Group clusters by root
+  sim->RelabelClusters(); // Dense cluster ids by decreasing size
 
   if (sim->includeWalks)
   {
-    sim->RandomWalks();  // Run the random walks
-    sim->AddNoise();     // Add noise to walks
-    sim->AnalyseWalks(); // Calculate statistics for walks
+    sim->BuildClusterIndex(); // Index the sites of each cluster
+    sim->BuildOccupancy();    // Pack occupied sites for the walks
+    sim->RandomWalks();       // Run the random walks
+    sim->AddNoise();          // Add noise to walks
+    sim->AnalyseWalks();      // Calculate statistics for walks
   }
 
+  sim->RestoreSiteOrder(); // Return sites in column-major order
+
   lattice = sim->latticeCoords;
   //clusters = sim->lattice;
-  clusters = sim->clusters;
+  clusters = arma::conv_to<arma::Col<int64_t>>::from(sim->clusters);
   analysis = sim->analysis;
-  walks = sim->walksCoords;
+  walks = std::move(sim->walksCoords); // Hand over the walks without a copy
+  wrappingX = sim->wrapping[0]; // Occupation number at which a cluster first wraps, or 0
+  wrappingY = sim->wrapping[1];
+  labels = arma::conv_to<arma::Col<int64_t>>::from(sim->clusterIds);
+  labelSizes = arma::conv_to<arma::Col<int64_t>>::from(sim->clusterSizes);
 
   if (sim->includeWalks) // Armadillo is Fortran-contiguous, numpy is C-contiguous
   {
@@ -823,6 +2445,68 @@ uint64_t CTRWwrapper(
     arma::inplace_trans(analysis);
   }
 
+  return 0;
+};
+
+template <typename T, typename I = int64_t>
+uint64_t SweepWrapper(
+    arma::Mat<T> &sweep,
+    const arma::Col<T> &thresholds,
+    const uint64_t gridSize,
+    const uint64_t latticeType,
+    const int64_t randomSeed,
+    const int64_t nJobs,
+    const uint64_t siteOrder,
+    const uint64_t percolationType)
+{
+  CTRWfractal<T, I> *sim = new CTRWfractal<T, I>(
+      gridSize,
+      latticeType,
+      0.0,
+      0,
+      0,
+      0,
+      0.0,
+      1.0,
+      0.0,
+      randomSeed,
+      nJobs,
+      siteOrder,
+      percolationType,
+      0);
+
+  sim->FindNeighbours();   // Identify neighbouring sites
+  sim->Permute();          // Randomize the order in which the sites are occupied
+  sim->Sweep(thresholds);  // Run the percolation algorithm over all thresholds
+
+  sweep = sim->sweep; // One column per record, i.e. (n_records, 7) in numpy
+
+  delete sim;
+  return 0;
+};
+
+template <typename T>
+uint64_t HoshenKopelmanWrapper(
+    arma::Mat<T> &sizes,
+    uint64_t &nOccupied,
+    const uint64_t gridSize,
+    const double threshold,
+    const int64_t randomSeed)
+{
+  HoshenKopelman *sim = new HoshenKopelman(gridSize, threshold, randomSeed);
+
+  sim->Run(); // Label the lattice row by row
+
+  sizes.set_size(2, sim->sizes.size()); // One column per (size, count) pair
+  uint64_t k = 0;
+  for (const auto &entry : sim->sizes)
+  {
+    sizes(0, k) = static_cast<T>(entry.first);
+    sizes(1, k) = static_cast<T>(entry.second);
+    k++;
+  }
+  nOccupied = sim->nOccupied;
+
   delete sim;
   return 0;
 };
@@ -22,7 +22,7 @@ import numpy as np
 cimport numpy as np
 cimport cython
 from libcpp cimport bool
-from libc.stdint cimport uint64_t, int64_t
+from libc.stdint cimport uint64_t, int64_t, int32_t
 
 np.import_array()
 
@@ -137,12 +137,50 @@ cdef np.ndarray[np.double_t, ndim=3] numpy_from_cube_d(Cube[double] &m) except +
     return arr
 
 
+cdef bint small_indices(uint64_t grid_size, uint64_t lattice_type, uint64_t percolation_type):
+    # Use 32-bit site indices whenever the lattice is small enough,
+    # which halves the memory used by the percolation and walk arrays.
+    # Bonds are indexed as site * neighbour_count + slot, and the cell
+    # displacements stored alongside 32-bit indices need fewer than 2^30 sites
+    cdef uint64_t n_sites = 4 * grid_size * grid_size if lattice_type == 1 else grid_size * grid_size
+    cdef uint64_t n_indices = n_sites * (3 if lattice_type == 1 else 4) if percolation_type == 1 else n_sites
+
+    return n_indices < 2147483647 and n_sites < 1073741824
+
+
 cdef extern from "_ctrw.hpp":
-    cdef uint64_t c_ctrw "CTRWwrapper"[T] (Col[int64_t] &, Mat[T] &, Mat[T] &, Cube[T] &,
+    cdef uint64_t c_ctrw "CTRWwrapper"[T, I] (Col[int64_t] &, Mat[T] &, Mat[T] &, Cube[T] &,
+                                           uint64_t &, uint64_t &,
+                                           Col[int64_t] &, Col[int64_t] &,
                                            uint64_t, uint64_t, double,
                                            uint64_t, uint64_t, uint64_t,
                                            double, double, double,
-                                           int64_t, int64_t)
+                                           int64_t, int64_t, uint64_t, uint64_t,
+                                           uint64_t, uint64_t) except +
+
+    cdef uint64_t c_sweep "SweepWrapper"[T, I] (Mat[T] &, Col[T] &,
+                                                uint64_t, uint64_t,
+                                                int64_t, int64_t, uint64_t, uint64_t) except +
+
+    cdef uint64_t c_hoshen_kopelman "HoshenKopelmanWrapper"[T] (Mat[T] &, uint64_t &,
+                                                                uint64_t, double, int64_t)
+
+    cdef cppclass c_percolation_handle "PercolationHandle"[T, I]:
+        c_percolation_handle(uint64_t, uint64_t, double,
+                             int64_t, int64_t, uint64_t, uint64_t,
+                             uint64_t, uint64_t) except +
+
+        void Advance(double) except +
+
+        void Clusters(Col[int64_t] &, uint64_t &, uint64_t &)
+
+        void Lattice(Mat[T] &)
+
+        void Labels(Col[int64_t] &, Col[int64_t] &)
+
+        void ClusterSites(uint64_t, Col[int64_t] &)
+
+        void Statistics(Mat[T] &, Mat[T] &, uint64_t &)
 
 
 def ctrw_fractal(uint64_t grid_size = 32,
@@ -155,45 +193,298 @@ def ctrw_fractal(uint64_t grid_size = 32,
                  double tau0 = 1.0,
                  double noise = 0.0,
                  int64_t random_seed = -1,
-                 int64_t n_jobs = -1):
+                 int64_t n_jobs = -1,
+                 uint64_t site_order = 0,
+                 uint64_t labelling = 0,
+                 uint64_t percolation_type = 0,
+                 uint64_t occupancy = 0):
 
     cdef uint64_t result
+    cdef uint64_t wrapping_x = 0
+    cdef uint64_t wrapping_y = 0
 
     cdef np.ndarray[np.int64_t, ndim=1] clusters
     cdef np.ndarray[np.double_t, ndim=2] lattice
     cdef np.ndarray[np.double_t, ndim=2] analysis
     cdef np.ndarray[np.double_t, ndim=3] walks
+    cdef np.ndarray[np.int64_t, ndim=1] labels
+    cdef np.ndarray[np.int64_t, ndim=1] label_sizes
 
     cdef Col[int64_t] _clusters
     cdef Mat[double] _lattice
     cdef Mat[double] _analysis
     cdef Cube[double] _walks
+    cdef Col[int64_t] _labels
+    cdef Col[int64_t] _label_sizes
 
     _clusters = Col[int64_t]()
     _lattice = Mat[double]()
     _analysis = Mat[double]()
     _walks = Cube[double]()
-
-    result = c_ctrw[double](_clusters,
-                            _lattice,
-                            _analysis,
-                            _walks,
-                            grid_size,
-                            lattice_type,
-                            threshold,
-                            walk_type,
-                            n_walks,
-                            n_steps,
-                            beta,
-                            tau0,
-                            noise,
-                            random_seed,
-                            n_jobs)
+    _labels = Col[int64_t]()
+    _label_sizes = Col[int64_t]()
+
+    if small_indices(grid_size, lattice_type, percolation_type):
+        result = c_ctrw[double, int32_t](_clusters,
+                                         _lattice,
+                                         _analysis,
+                                         _walks,
+                                         wrapping_x,
+                                         wrapping_y,
+                                         _labels,
+                                         _label_sizes,
+                                         grid_size,
+                                         lattice_type,
+                                         threshold,
+                                         walk_type,
+                                         n_walks,
+                                         n_steps,
+                                         beta,
+                                         tau0,
+                                         noise,
+                                         random_seed,
+                                         n_jobs,
+                                         site_order,
+                                         labelling,
+                                         percolation_type,
+                                         occupancy)
+    else:
+        result = c_ctrw[double, int64_t](_clusters,
+                                         _lattice,
+                                         _analysis,
+                                         _walks,
+                                         wrapping_x,
+                                         wrapping_y,
+                                         _labels,
+                                         _label_sizes,
+                                         grid_size,
+                                         lattice_type,
+                                         threshold,
+                                         walk_type,
+                                         n_walks,
+                                         n_steps,
+                                         beta,
+                                         tau0,
+                                         noise,
+                                         random_seed,
+                                         n_jobs,
+                                         site_order,
+                                         labelling,
+                                         percolation_type,
+                                         occupancy)
 
     clusters = numpy_from_col_i(_clusters)
     lattice = numpy_from_mat_d(_lattice)
     analysis = numpy_from_mat_d(_analysis)
     walks = numpy_from_cube_d(_walks)
+    labels = numpy_from_col_i(_labels)
+    label_sizes = numpy_from_col_i(_label_sizes)
+
+    wrapping = np.array([wrapping_x, wrapping_y], dtype=np.int64)
+
+    return clusters, lattice, walks, analysis, wrapping, labels, label_sizes, result
+
+
+def percolation_sweep(np.ndarray[np.double_t, ndim=1, mode="c"] thresholds,
+                      uint64_t grid_size = 32,
+                      uint64_t lattice_type = 0,
+                      int64_t random_seed = -1,
+                      int64_t n_jobs = -1,
+                      uint64_t site_order = 0,
+                      uint64_t percolation_type = 0):
+
+    cdef uint64_t result
+
+    cdef np.ndarray[np.double_t, ndim=2] sweep
+
+    cdef Col[double] _thresholds
+    cdef Mat[double] _sweep
+
+    _thresholds = Col[double](<double*> np.PyArray_DATA(thresholds), thresholds.shape[0], True, False)
+    _sweep = Mat[double]()
+
+    if small_indices(grid_size, lattice_type, percolation_type):
+        result = c_sweep[double, int32_t](_sweep,
+                                          _thresholds,
+                                          grid_size,
+                                          lattice_type,
+                                          random_seed,
+                                          n_jobs,
+                                          site_order,
+                                          percolation_type)
+    else:
+        result = c_sweep[double, int64_t](_sweep,
+                                          _thresholds,
+                                          grid_size,
+                                          lattice_type,
+                                          random_seed,
+                                          n_jobs,
+                                          site_order,
+                                          percolation_type)
+
+    sweep = numpy_from_mat_d(_sweep)
+
+    return sweep, result
+
+
+def hoshen_kopelman(uint64_t grid_size = 32,
+                    double threshold = 0.0,
+                    int64_t random_seed = -1):
+
+    cdef uint64_t result
+    cdef uint64_t n_occupied = 0
+
+    cdef np.ndarray[np.double_t, ndim=2] sizes
+
+    cdef Mat[double] _sizes
+    _sizes = Mat[double]()
+
+    result = c_hoshen_kopelman[double](_sizes,
+                                       n_occupied,
+                                       grid_size,
+                                       threshold,
+                                       random_seed)
+
+    sizes = numpy_from_mat_d(_sizes)
+
+    return sizes, n_occupied, result
+
+
+cdef class PercolationHandle:
+    """Percolation state on one disorder realisation that can be advanced
+    to higher thresholds without repeating the unions already performed."""
+
+    cdef c_percolation_handle[double, int32_t] *_handle32
+    cdef c_percolation_handle[double, int64_t] *_handle64
+
+    def __cinit__(self,
+                  uint64_t grid_size = 32,
+                  uint64_t lattice_type = 0,
+                  double threshold = 0.0,
+                  int64_t random_seed = -1,
+                  int64_t n_jobs = -1,
+                  uint64_t site_order = 0,
+                  uint64_t labelling = 0,
+                  uint64_t percolation_type = 0,
+                  uint64_t occupancy = 0):
+
+        if small_indices(grid_size, lattice_type, percolation_type):
+            self._handle32 = new c_percolation_handle[double, int32_t](grid_size,
+                                                                       lattice_type,
+                                                                       threshold,
+                                                                       random_seed,
+                                                                       n_jobs,
+                                                                       site_order,
+                                                                       labelling,
+                                                                       percolation_type,
+                                                                       occupancy)
+        else:
+            self._handle64 = new c_percolation_handle[double, int64_t](grid_size,
+                                                                       lattice_type,
+                                                                       threshold,
+                                                                       random_seed,
+                                                                       n_jobs,
+                                                                       site_order,
+                                                                       labelling,
+                                                                       percolation_type,
+                                                                       occupancy)
+
+    def __dealloc__(self):
+        del self._handle32
+        del self._handle64
+
+    def advance(self, double threshold):
+        if self._handle32 != NULL:
+            self._handle32.Advance(threshold)
+        else:
+            self._handle64.Advance(threshold)
+
+    def clusters(self):
+        cdef uint64_t wrapping_x = 0
+        cdef uint64_t wrapping_y = 0
+
+        cdef np.ndarray[np.int64_t, ndim=1] clusters
+
+        cdef Col[int64_t] _clusters
+        _clusters = Col[int64_t]()
+
+        if self._handle32 != NULL:
+            self._handle32.Clusters(_clusters, wrapping_x, wrapping_y)
+        else:
+            self._handle64.Clusters(_clusters, wrapping_x, wrapping_y)
+
+        clusters = numpy_from_col_i(_clusters)
+
+        wrapping = np.array([wrapping_x, wrapping_y], dtype=np.int64)
+
+        return clusters, wrapping
+
+    def lattice(self):
+        cdef np.ndarray[np.double_t, ndim=2] lattice
+
+        cdef Mat[double] _lattice
+        _lattice = Mat[double]()
+
+        if self._handle32 != NULL:
+            self._handle32.Lattice(_lattice)
+        else:
+            self._handle64.Lattice(_lattice)
+
+        lattice = numpy_from_mat_d(_lattice)
+
+        return lattice
+
+    def labels(self):
+        cdef np.ndarray[np.int64_t, ndim=1] labels
+        cdef np.ndarray[np.int64_t, ndim=1] label_sizes
+
+        cdef Col[int64_t] _labels
+        cdef Col[int64_t] _label_sizes
+        _labels = Col[int64_t]()
+        _label_sizes = Col[int64_t]()
+
+        if self._handle32 != NULL:
+            self._handle32.Labels(_labels, _label_sizes)
+        else:
+            self._handle64.Labels(_labels, _label_sizes)
+
+        labels = numpy_from_col_i(_labels)
+        label_sizes = numpy_from_col_i(_label_sizes)
+
+        return labels, label_sizes
+
+    def cluster_sites(self, uint64_t label):
+        cdef np.ndarray[np.int64_t, ndim=1] sites
+
+        cdef Col[int64_t] _sites
+        _sites = Col[int64_t]()
+
+        if self._handle32 != NULL:
+            self._handle32.ClusterSites(label, _sites)
+        else:
+            self._handle64.ClusterSites(label, _sites)
+
+        sites = numpy_from_col_i(_sites)
+
+        return sites
+
+    def statistics(self):
+        cdef uint64_t largest = 0
+
+        cdef np.ndarray[np.double_t, ndim=2] sizes
+        cdef np.ndarray[np.double_t, ndim=2] radii
+
+        cdef Mat[double] _sizes
+        cdef Mat[double] _radii
+        _sizes = Mat[double]()
+        _radii = Mat[double]()
+
+        if self._handle32 != NULL:
+            self._handle32.Statistics(_sizes, _radii, largest)
+        else:
+            self._handle64.Statistics(_sizes, _radii, largest)
 
-    return clusters, lattice, walks, analysis, result
+        sizes = numpy_from_mat_d(_sizes)
+        radii = numpy_from_mat_d(_radii)
 
+        return sizes, radii, largest
@@ -23,7 +23,12 @@ from matplotlib.collections import PatchCollection
 from matplotlib.lines import Line2D
 from matplotlib.patches import Circle, Patch
 
-from ._ctrwfractal import ctrw_fractal
+from ._ctrwfractal import (
+    PercolationHandle,
+    ctrw_fractal,
+    hoshen_kopelman,
+    percolation_sweep,
+)
 
 
 class CTRWfractal:
@@ -52,9 +57,9 @@ class CTRWfractal:
         - If "honeycomb", then a 2D honeycomb (or graphene) lattice
           is generated.
     threshold : None or float, default=None
-        The fraction of occupied sites on the lattice. If None,
-        then the critical percolation threshold for the given
-        ``lattice_type`` is used.
+        The fraction of occupied sites (or bonds) on the lattice. If
+        None, then the critical percolation threshold for the given
+        ``lattice_type`` and ``percolation_type`` is used.
     walk_type : str {"all", "largest"}, default="all"
         - If "all", then the random walks can occur on any of the
           clusters on the 2D lattice.
@@ -75,16 +80,53 @@ class CTRWfractal:
     random_seed : None or int, default=None
         Random seed to use for the cluster generation and random walks.
     n_jobs : None or int, default=None
-        The number of threads to use for the random walk analysis, which
-        is performed in parallel over ``n_walks``. A value of None means
-        using a single thread, while -1 means using all threads dependent
-        on the available hardware.
+        The number of threads to use for the random walks and their
+        analysis, which are performed in parallel over ``n_walks``.
+        Each walk draws from its own random stream, so the walks do not
+        depend on ``n_jobs``. A value of None means using a single
+        thread, while -1 means using all threads dependent on the
+        available hardware.
+    site_order : str {"column", "morton"}, default="column"
+        - If "column", then lattice sites are stored column-by-column.
+        - If "morton", then lattice sites are stored along a Morton
+          (Z-order) curve, which keeps neighbouring sites close in
+          memory and speeds up large simulations. Requires
+          ``grid_size`` to be a power of 2.
+        Results are returned in column order in both cases.
+    percolation_type : str {"site", "bond"}, default="site"
+        - If "site", then lattice sites are occupied and clusters are
+          formed by neighbouring occupied sites.
+        - If "bond", then every site is present and the bonds between
+          neighbouring sites are occupied. Clusters are formed by sites
+          joined by occupied bonds, and random walks only move along
+          occupied bonds.
+    labelling : str {"sequential", "parallel"}, default="sequential"
+        - If "sequential", then clusters are labelled by adding the
+          occupied sites one at a time.
+        - If "parallel", then the occupied sites are decided up front
+          and the clusters are labelled concurrently over ``n_jobs``
+          threads. The clusters are identical, but ``wrapping_`` is
+          not computed.
+    occupancy : str {"fixed", "bernoulli"}, default="fixed"
+        - If "fixed", then exactly ``threshold`` times the number of
+          sites (or bonds) are occupied, taken from a random
+          permutation as in [New2001]_.
+        - If "bernoulli", then each site is occupied independently with
+          probability ``threshold``, which skips the permutation. Only
+          available for site percolation, and not with ``sweep`` or
+          ``advance``.
 
     Attributes
     ----------
     clusters_ : array-like, shape (n_sites,)
         Labelled clusters indicated occupied and unoccupied sites,
         with distinct clusters uniquely labelled.
+    labels_ : array-like, shape (n_sites,)
+        Dense cluster labels from 0 to n_clusters - 1, in order of
+        decreasing cluster size (ties are ordered by their first site),
+        with -1 for unoccupied sites.
+    label_sizes_ : array-like, shape (n_clusters,)
+        Number of sites in each cluster of ``labels_``.
     lattice_ : array-like, shape (2, n_sites)
         Physical (x, y) coordinates of the lattice sites in 2D.
     walks_ : None or array-like, shape (n_walks, n_steps, 2)
@@ -97,7 +139,33 @@ class CTRWfractal:
         mean-squared displacement (TAMSD), ergodicity-breaking values,
         and TAMSD for each trajectory.
     occupied_fraction_ : float
-        Fraction of lattice sites marked as occupied.
+        Fraction of lattice sites marked as occupied. This is 1.0
+        for bond percolation.
+    wrapping_ : array-like, shape (2,)
+        Number of occupied sites (or bonds, if ``percolation_type`` is
+        "bond") at which a cluster first wraps around the periodic
+        lattice in the x and y directions, or 0 if no cluster wraps
+        below ``threshold``. None if ``labelling`` is "parallel". If
+        ``occupancy`` is "bernoulli", the sites are not occupied in
+        order, so this is the total number of occupied sites if a
+        cluster wraps.
+    sweep_ : None or pandas.DataFrame
+        If ``sweep`` has been called, this is a dataframe containing
+        the occupied fraction, number of occupied sites, largest cluster
+        size, mean cluster size, number of clusters and whether a
+        cluster wraps in the x and y directions at each of the
+        requested thresholds.
+    cluster_sizes_ : None or pandas.DataFrame
+        If ``run_out_of_core`` or ``cluster_statistics`` has been called,
+        this is a dataframe containing each cluster size and the number
+        of clusters of that size.
+    cluster_radii_ : None or pandas.DataFrame
+        If ``cluster_statistics`` has been called, this is a dataframe
+        containing the size and radius of gyration of each cluster,
+        in the same order as ``label_sizes_``.
+    largest_cluster_ : None or int
+        If ``cluster_statistics`` has been called, the number of sites
+        in the largest cluster.
 
     Notes
     -----
@@ -126,6 +194,10 @@ class CTRWfractal:
         noise=None,
         random_seed=None,
         n_jobs=None,
+        site_order="column",
+        labelling="sequential",
+        percolation_type="site",
+        occupancy="fixed",
     ):
         self.grid_size = grid_size
         self.lattice_type = lattice_type
@@ -138,7 +210,16 @@ class CTRWfractal:
         self.noise = noise
         self.random_seed = random_seed
         self.n_jobs = n_jobs
-
+        self.site_order = site_order
+        self.labelling = labelling
+        self.percolation_type = percolation_type
+        self.occupancy = occupancy
+
+        self.sweep_ = None
+        self.cluster_sizes_ = None
+        self.cluster_radii_ = None
+        self.largest_cluster_ = None
+        self._handle = None
         self._has_run = False
 
     def _analysis_to_df(self, analysis, copy=True):
@@ -166,15 +247,26 @@ class CTRWfractal:
     def _check_arguments(self):
         """Sanity-checking of arguments before calling C++ code."""
         lattice_types = {"square": 0, "honeycomb": 1}
-        lattice_thresholds = {"square": 0.592746, "honeycomb": 0.697040230}
+        lattice_thresholds = {
+            "site": {"square": 0.592746, "honeycomb": 0.697040230},
+            "bond": {"square": 0.5, "honeycomb": 0.652703645},
+        }
         walk_types = {"all": 0, "largest": 1}
+        site_orders = {"column": 0, "morton": 1}
+        labellings = {"sequential": 0, "parallel": 1}
+        percolation_types = {"site": 0, "bond": 1}
+        occupancies = {"fixed": 0, "bernoulli": 1}
 
         self.lattice_type_ = lattice_types.get(self.lattice_type, None)
         self.walk_type_ = walk_types.get(self.walk_type, None)
+        self.site_order_ = site_orders.get(self.site_order, None)
+        self.labelling_ = labellings.get(self.labelling, None)
+        self.percolation_type_ = percolation_types.get(self.percolation_type, None)
+        self.occupancy_ = occupancies.get(self.occupancy, None)
 
         # If no threshold given, use the critical values
         self.threshold_ = (
-            lattice_thresholds.get(self.lattice_type, 0.0)
+            lattice_thresholds.get(self.percolation_type, {}).get(self.lattice_type, 0.0)
             if self.threshold is None
             else self.threshold
         )
@@ -201,6 +293,44 @@ class CTRWfractal:
                 f"instead of one of {walk_types.keys()}"
             )
 
+        if self.site_order_ is None:
+            raise ValueError(
+                f"Invalid site_order parameter: got '{self.site_order}' "
+                f"instead of one of {site_orders.keys()}"
+            )
+
+        if self.percolation_type_ is None:
+            raise ValueError(
+                f"Invalid percolation_type parameter: got '{self.percolation_type}' "
+                f"instead of one of {percolation_types.keys()}"
+            )
+
+        if self.labelling_ is None:
+            raise ValueError(
+                f"Invalid labelling parameter: got '{self.labelling}' "
+                f"instead of one of {labellings.keys()}"
+            )
+
+        if self.occupancy_ is None:
+            raise ValueError(
+                f"Invalid occupancy parameter: got '{self.occupancy}' "
+                f"instead of one of {occupancies.keys()}"
+            )
+
+        if self.occupancy_ == 1 and self.percolation_type_ != 0:
+            raise ValueError(
+                f"Invalid occupancy parameter: 'bernoulli' only supports "
+                f"'site' percolation, got '{self.percolation_type}'"
+            )
+
+        if self.site_order_ == 1 and (
+            self.grid_size < 1 or (self.grid_size & (self.grid_size - 1)) != 0
+        ):
+            raise ValueError(
+                f"Invalid site_order parameter: 'morton' requires grid_size "
+                f"to be a power of 2, got '{self.grid_size}'"
+            )
+
         if self.threshold_ < 0.0 or self.threshold_ > 1.0:
             raise ValueError(
                 f"Invalid threshold parameter: got '{self.threshold_}' "
@@ -255,10 +385,16 @@ class CTRWfractal:
             walk_type=self.walk_type_,
             random_seed=self.random_seed_,
             n_jobs=self.n_jobs_,
+            site_order=self.site_order_,
+            labelling=self.labelling_,
+            percolation_type=self.percolation_type_,
+            occupancy=self.occupancy_,
         )
 
         self.clusters_ = res[0]
         self.lattice_ = res[1]
+        self.labels_ = res[5]
+        self.label_sizes_ = res[6]
 
         if self.n_walks_ > 0 and self.n_steps_ > 0:
             self.walks_ = res[2]
@@ -267,14 +403,310 @@ class CTRWfractal:
             self.walks_ = None
             self.analysis_ = None
 
+        # Empty sites are labelled -(n_sites + 1)
         self.occupied_fraction_ = (
-            np.sum(self.clusters_ > self.clusters_.min()) / self.clusters_.size
+            np.sum(self.clusters_ >= -self.clusters_.size) / self.clusters_.size
+        )
+        self.wrapping_ = res[4] if self.labelling_ == 0 else None
+
+        self._has_run = True
+
+        return self
+
+    def sweep(self, thresholds=None):
+        """Percolation statistics over a range of thresholds in a single run.
+
+        Following [New2001]_, the sites are occupied one at a time in random
+        order, so the cluster statistics for every occupation number come
+        from a single pass over the lattice. The ``threshold``, ``walk_type``,
+        ``n_walks`` and related parameters are ignored.
+
+        The mean cluster size is the average size of the cluster containing
+        a randomly chosen occupied site, i.e. sum(s^2) / sum(s). For bond
+        percolation, the bonds are occupied instead, so the occupied
+        fraction and ``OccupiedSites`` count bonds.
+        The wrapping columns indicate whether any cluster wraps around the
+        periodic lattice, so averaging them over many seeds gives the
+        wrapping probability used to estimate the critical threshold.
+
+        Parameters
+        ----------
+        thresholds : None or array-like of float, default=None
+            The fractions of occupied sites (or bonds) at which to record
+            the statistics. If None, they are recorded after every added
+            site (or bond).
+
+        Returns
+        -------
+        self : object
+            Returns the instance itself.
+
+        """
+        self._check_arguments()
+
+        if self.occupancy_ != 0:
+            raise ValueError(
+                f"Invalid occupancy parameter: sweep only supports "
+                f"'fixed', got '{self.occupancy}'"
+            )
+
+        if thresholds is None:
+            thresholds_ = np.empty(0, dtype=np.float64)
+        else:
+            thresholds_ = np.sort(np.ravel(np.asarray(thresholds, dtype=np.float64)))
+
+            if thresholds_.size > 0 and (thresholds_[0] < 0.0 or thresholds_[-1] > 1.0):
+                raise ValueError(
+                    f"Invalid thresholds parameter: got '{thresholds}' "
+                    f"instead of floats between 0.0 and 1.0"
+                )
+
+        res = percolation_sweep(
+            np.ascontiguousarray(thresholds_),
+            grid_size=self.grid_size,
+            lattice_type=self.lattice_type_,
+            random_seed=self.random_seed_,
+            n_jobs=self.n_jobs_,
+            site_order=self.site_order_,
+            percolation_type=self.percolation_type_,
+        )
+
+        columns = [
+            "OccupiedFraction",
+            "OccupiedSites",
+            "LargestCluster",
+            "MeanClusterSize",
+            "NumClusters",
+            "WrappingX",
+            "WrappingY",
+        ]
+        self.sweep_ = pd.DataFrame(res[0], columns=columns, copy=True)
+
+        return self
+
+    def run_out_of_core(self):
+        """Cluster size statistics for lattices too large to hold in memory.
+
+        The square lattice is labelled row by row with the Hoshen-Kopelman
+        algorithm, keeping only O(``grid_size``) labels in memory, so the
+        cluster labels, lattice coordinates and random walks are not
+        available. Each site is occupied independently with probability
+        ``threshold``, giving the same clusters as ``run`` with
+        ``occupancy="bernoulli"`` and the same ``random_seed``.
+
+        Parameters
+        ----------
+        None
+
+        Returns
+        -------
+        self : object
+            Returns the instance itself.
+
+        """
+        self._check_arguments()
+
+        if self.lattice_type_ != 0:
+            raise ValueError(
+                f"Invalid lattice_type parameter: run_out_of_core only supports "
+                f"'square', got '{self.lattice_type}'"
+            )
+
+        if self.percolation_type_ != 0:
+            raise ValueError(
+                f"Invalid percolation_type parameter: run_out_of_core only supports "
+                f"'site', got '{self.percolation_type}'"
+            )
+
+        res = hoshen_kopelman(
+            grid_size=self.grid_size,
+            threshold=self.threshold_,
+            random_seed=self.random_seed_,
+        )
+
+        self.cluster_sizes_ = pd.DataFrame(
+            res[0], columns=["Size", "Count"], copy=True
+        ).astype(np.int64)
+        self.occupied_fraction_ = res[1] / self.grid_size ** 2
+
+        return self
+
+    def percolate(self):
+        """Generate the percolation clusters, keeping the state for ``advance``.
+
+        Equivalent to ``run`` without random walks, except that the
+        occupation order and cluster labels are kept, so the clusters
+        at higher thresholds on the same disorder realisation can be
+        obtained with ``advance``.
+
+        Parameters
+        ----------
+        None
+
+        Returns
+        -------
+        self : object
+            Returns the instance itself.
+
+        """
+        self._check_arguments()
+
+        self._handle = PercolationHandle(
+            grid_size=self.grid_size,
+            lattice_type=self.lattice_type_,
+            threshold=self.threshold_,
+            random_seed=self.random_seed_,
+            n_jobs=self.n_jobs_,
+            site_order=self.site_order_,
+            labelling=self.labelling_,
+            percolation_type=self.percolation_type_,
+            occupancy=self.occupancy_,
         )
 
+        self.lattice_ = self._handle.lattice()
+        self.walks_ = None
+        self.analysis_ = None
+        self._update_clusters()
+
         self._has_run = True
 
         return self
 
+    def advance(self, threshold):
+        """Continue the percolation started by ``percolate`` to a higher threshold.
+
+        Only the sites (or bonds) between the current and new thresholds
+        are added, and the clusters are identical to those from ``run``
+        with the same ``random_seed`` at the new threshold.
+
+        Parameters
+        ----------
+        threshold : float
+            The new fraction of occupied sites (or bonds), which must
+            not be lower than the current ``threshold_``.
+
+        Returns
+        -------
+        self : object
+            Returns the instance itself.
+
+        """
+        if self._handle is None:
+            raise ValueError("percolate must be called before advance")
+
+        if self.occupancy_ != 0:
+            raise ValueError(
+                f"Invalid occupancy parameter: advance only supports "
+                f"'fixed', got '{self.occupancy}'"
+            )
+
+        if threshold < self.threshold_ or threshold > 1.0:
+            raise ValueError(
+                f"Invalid threshold parameter: got '{threshold}' "
+                f"instead of a float between {self.threshold_} and 1.0"
+            )
+
+        self.threshold_ = threshold
+        self._handle.advance(threshold)
+        self._update_clusters()
+
+        return self
+
+    def cluster_sites(self, label):
+        """Sites in one cluster of the current percolation state.
+
+        The sites of every cluster are indexed once after ``percolate``
+        or ``advance``, so each call takes time proportional to the
+        size of the cluster.
+
+        Parameters
+        ----------
+        label : int
+            Cluster label, as in ``labels_``, where 0 is the largest
+            cluster.
+
+        Returns
+        -------
+        sites : array-like, shape (n_cluster_sites,)
+            Indices into ``clusters_`` of the sites in the cluster, in
+            increasing order. Empty if there is no such cluster.
+
+        """
+        if self._handle is None:
+            raise ValueError("percolate must be called before cluster_sites")
+
+        if label < 0:
+            raise ValueError(
+                f"Invalid label parameter: got '{label}' instead of an int >= 0"
+            )
+
+        return self._handle.cluster_sites(label)
+
+    def cluster_statistics(self):
+        """Cluster size distribution and radii of gyration.
+
+        These are computed without returning the cluster labels, so
+        they are cheap to obtain for large lattices. If ``percolate``
+        has been called, the statistics are those at the current
+        ``threshold_``, otherwise the clusters are generated as in
+        ``run`` without random walks.
+
+        The radius of gyration is computed after unwrapping each cluster
+        across the periodic boundaries. For a cluster that wraps around
+        the lattice, this depends on the unwrapping chosen.
+
+        Parameters
+        ----------
+        None
+
+        Returns
+        -------
+        self : object
+            Returns the instance itself.
+
+        """
+        if self._handle is None:
+            self._check_arguments()
+
+            handle = PercolationHandle(
+                grid_size=self.grid_size,
+                lattice_type=self.lattice_type_,
+                threshold=self.threshold_,
+                random_seed=self.random_seed_,
+                n_jobs=self.n_jobs_,
+                site_order=self.site_order_,
+                labelling=self.labelling_,
+                percolation_type=self.percolation_type_,
+                occupancy=self.occupancy_,
+            )
+        else:
+            handle = self._handle
+
+        res = handle.statistics()
+
+        self.cluster_sizes_ = pd.DataFrame(
+            res[0], columns=["Size", "Count"], copy=True
+        ).astype(np.int64)
+        self.cluster_radii_ = pd.DataFrame(
+            res[1], columns=["Size", "RadiusOfGyration"], copy=True
+        ).astype({"Size": np.int64})
+        self.largest_cluster_ = res[2]
+
+        return self
+
+    def _update_clusters(self):
+        """Copy the clusters from the percolation handle."""
+        clusters, wrapping = self._handle.clusters()
+
+        self.clusters_ = clusters
+        self.labels_, self.label_sizes_ = self._handle.labels()
+
+        # Empty sites are labelled -(n_sites + 1)
+        self.occupied_fraction_ = (
+            np.sum(self.clusters_ >= -self.clusters_.size) / self.clusters_.size
+        )
+        self.wrapping_ = wrapping if self.labelling_ == 0 else None
+
     def plot_lattice(self, ax=None):
         if not self._has_run:
             self.run()
@@ -37,9 +37,9 @@ class TestSquare:
     @pytest.mark.parametrize(
         "threshold, expected_threshold, expected_clusters_hash",
         [
-            (None, 0.592746, "a77f4546"),
-            (0.55, 0.55, "079d302b"),
-            (0.65, 0.65, "e16909db"),
+            (None, 0.592746, "533de91d"),
+            (0.55, 0.55, "0f77099f"),
+            (0.65, 0.65, "9c0c3af7"),
         ],
     )
     def test_square_no_walks(
@@ -94,6 +94,47 @@ class TestSquare:
         assert s.walks_.shape == (n_walks, n_steps, 2)
         assert s.analysis_.shape == (n_steps - 1, n_walks + 3)
 
+    @pytest.mark.parametrize("beta", [None, 0.7])
+    def test_square_walks_n_jobs(self, beta):
+        s = [
+            CTRWfractal(
+                grid_size=self.grid_size,
+                lattice_type="square",
+                n_walks=20,
+                n_steps=50,
+                beta=beta,
+                random_seed=self.seed,
+                n_jobs=n_jobs,
+            ).run()
+            for n_jobs in [1, 4]
+        ]
+
+        np.testing.assert_array_equal(s[0].walks_, s[1].walks_)
+
+    @pytest.mark.parametrize("beta, tau0", [(0.5, 0.05), (1.5, 0.5), (0.8, 2.0)])
+    def test_square_ctrw_walks(self, beta, tau0):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type="square",
+            n_walks=10,
+            n_steps=200,
+            beta=beta,
+            tau0=tau0,
+            random_seed=self.seed,
+        ).run()
+
+        assert s.walks_.shape == (10, 200, 2)
+
+        # The walks stay on the (unwrapped) lattice sites
+        np.testing.assert_allclose(s.walks_, np.round(s.walks_), atol=1e-9)
+
+        # Waiting times are at least tau0, so there are at most
+        # ceil(1 / tau0) jumps of unit length per time step
+        step = np.abs(np.diff(s.walks_, axis=1)).sum(axis=-1)
+        assert np.all(step <= np.ceil(1.0 / tau0) + 1e-9)
+        if tau0 < 1.0:
+            assert np.any(step > 1.0 + 1e-9)
+
 
 class TestHoneycomb:
     def setup_method(self, method):
@@ -103,9 +144,9 @@ class TestHoneycomb:
     @pytest.mark.parametrize(
         "threshold, expected_threshold, expected_clusters_hash",
         [
-            (None, 0.697040230, "c24af7ff"),
-            (0.65, 0.65, "9c13bf6b"),
-            (0.75, 0.75, "7d1c6d3d"),
+            (None, 0.697040230, "76f9e274"),
+            (0.65, 0.65, "1f4994c7"),
+            (0.75, 0.75, "0b3c2553"),
         ],
     )
     def test_honeycomb_no_walks(
@@ -161,6 +202,509 @@ class TestHoneycomb:
         assert s.analysis_.shape == (n_steps - 1, n_walks + 3)
 
 
+class TestSiteOrder:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 32
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_morton_matches_column(self, lattice_type):
+        s = [
+            CTRWfractal(
+                grid_size=self.grid_size,
+                lattice_type=lattice_type,
+                random_seed=self.seed,
+                site_order=site_order,
+            ).run()
+            for site_order in ["column", "morton"]
+        ]
+
+        np.testing.assert_array_equal(s[0].clusters_, s[1].clusters_)
+        np.testing.assert_allclose(s[0].lattice_, s[1].lattice_)
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_morton_with_walks(self, lattice_type):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            n_walks=2,
+            n_steps=25,
+            random_seed=self.seed,
+            site_order="morton",
+        )
+        s.run()
+
+        assert s.walks_.shape == (2, 25, 2)
+
+        # Each step is either a wait or a jump of unit length
+        step = np.linalg.norm(np.diff(s.walks_, axis=1), axis=-1)
+        assert np.all((step < 1e-9) | (np.abs(step - 1.0) < 1e-9))
+
+
+class TestBond:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 32
+
+    @pytest.mark.parametrize(
+        "lattice_type, expected_threshold",
+        [("square", 0.5), ("honeycomb", 0.652703645)],
+    )
+    def test_bond(self, lattice_type, expected_threshold):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            percolation_type="bond",
+            random_seed=self.seed,
+        ).run()
+
+        assert s.threshold_ == expected_threshold
+        assert s.occupied_fraction_ == 1.0
+
+        # Each site is labelled with the (negated) size of its cluster
+        sizes, counts = np.unique(s.clusters_, return_counts=True)
+        np.testing.assert_array_equal(counts % -sizes, 0)
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_bond_matches_parallel(self, lattice_type):
+        s = [
+            CTRWfractal(
+                grid_size=self.grid_size,
+                lattice_type=lattice_type,
+                percolation_type="bond",
+                random_seed=self.seed,
+                n_jobs=4,
+                labelling=labelling,
+            ).run()
+            for labelling in ["sequential", "parallel"]
+        ]
+
+        np.testing.assert_array_equal(s[0].clusters_, s[1].clusters_)
+
+    @pytest.mark.parametrize(
+        "lattice_type, n_bonds", [("square", 2 * 32 * 32), ("honeycomb", 6 * 32 * 32)]
+    )
+    def test_bond_sweep(self, lattice_type, n_bonds):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            percolation_type="bond",
+            random_seed=self.seed,
+        ).sweep()
+
+        assert s.sweep_.shape == (n_bonds, 7)
+        assert s.sweep_["LargestCluster"].iloc[-1] == s.sweep_["MeanClusterSize"].iloc[-1]
+        assert s.sweep_["NumClusters"].iloc[-1] == 1
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_bond_walks(self, lattice_type):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            percolation_type="bond",
+            n_walks=2,
+            n_steps=25,
+            random_seed=self.seed,
+        ).run()
+
+        assert s.walks_.shape == (2, 25, 2)
+
+        # Each step is either a wait or a jump of unit length
+        step = np.linalg.norm(np.diff(s.walks_, axis=1), axis=-1)
+        assert np.all((step < 1e-9) | (np.abs(step - 1.0) < 1e-9))
+
+
+class TestLabelling:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 32
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    @pytest.mark.parametrize("threshold", [0.55, 0.65, 0.75])
+    def test_parallel_matches_sequential(self, lattice_type, threshold):
+        s = [
+            CTRWfractal(
+                grid_size=self.grid_size,
+                lattice_type=lattice_type,
+                threshold=threshold,
+                random_seed=self.seed,
+                n_jobs=4,
+                labelling=labelling,
+            ).run()
+            for labelling in ["sequential", "parallel"]
+        ]
+
+        np.testing.assert_array_equal(s[0].clusters_, s[1].clusters_)
+        assert s[0].wrapping_ is not None
+        assert s[1].wrapping_ is None
+
+
+class TestOccupancy:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 64
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    @pytest.mark.parametrize("threshold", [0.3, 0.6, 0.9])
+    def test_bernoulli(self, lattice_type, threshold):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=threshold,
+            random_seed=self.seed,
+            occupancy="bernoulli",
+        ).run()
+
+        n_sites = s.clusters_.shape[0]
+        n_occupied = np.sum(s.labels_ >= 0)
+        assert abs(s.occupied_fraction_ - threshold) < 0.05
+        assert s.occupied_fraction_ == n_occupied / n_sites
+        assert np.sum(s.label_sizes_) == n_occupied
+        assert np.all(np.isin(s.wrapping_, [0, n_occupied]))
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_bernoulli_matches_parallel(self, lattice_type):
+        s = [
+            CTRWfractal(
+                grid_size=self.grid_size,
+                lattice_type=lattice_type,
+                threshold=0.65,
+                random_seed=self.seed,
+                n_jobs=n_jobs,
+                labelling=labelling,
+                occupancy="bernoulli",
+            ).run()
+            for labelling, n_jobs in [("sequential", 1), ("parallel", 4)]
+        ]
+
+        np.testing.assert_array_equal(s[0].clusters_, s[1].clusters_)
+        np.testing.assert_array_equal(s[0].labels_, s[1].labels_)
+
+
+class TestSweep:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 32
+
+    @pytest.mark.parametrize(
+        "lattice_type, n_sites", [("square", 32 * 32), ("honeycomb", 4 * 32 * 32)]
+    )
+    def test_sweep_all(self, lattice_type, n_sites):
+        s = CTRWfractal(
+            grid_size=self.grid_size, lattice_type=lattice_type, random_seed=self.seed,
+        )
+        s.sweep()
+
+        assert isinstance(s.sweep_, pd.DataFrame)
+        assert s.sweep_.shape == (n_sites, 7)
+
+        np.testing.assert_array_equal(s.sweep_["OccupiedSites"], np.arange(1, n_sites + 1))
+        assert np.all(np.diff(s.sweep_["LargestCluster"]) >= 0)
+
+        # Fully occupied lattice is a single cluster
+        last = s.sweep_.iloc[-1]
+        assert last["LargestCluster"] == n_sites
+        assert last["MeanClusterSize"] == n_sites
+        assert last["NumClusters"] == 1
+        assert last["WrappingX"] == 1
+        assert last["WrappingY"] == 1
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_wrapping(self, lattice_type):
+        s = CTRWfractal(
+            grid_size=self.grid_size, lattice_type=lattice_type, random_seed=self.seed,
+        )
+        s.sweep()
+
+        r = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=1.0,
+            random_seed=self.seed,
+        ).run()
+
+        # First occupation at which a wrapping cluster appears
+        for i, col in enumerate(["WrappingX", "WrappingY"]):
+            assert r.wrapping_[i] > 0
+            first = s.sweep_["OccupiedSites"][s.sweep_[col] == 1].min()
+            assert r.wrapping_[i] == first
+
+    def test_no_wrapping(self):
+        s = CTRWfractal(
+            grid_size=self.grid_size, threshold=0.2, random_seed=self.seed,
+        ).run()
+
+        np.testing.assert_array_equal(s.wrapping_, [0, 0])
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_sweep_matches_run(self, lattice_type):
+        thresholds = [0.55, 0.65, 0.75]
+        s = CTRWfractal(
+            grid_size=self.grid_size, lattice_type=lattice_type, random_seed=self.seed,
+        )
+        s.sweep(thresholds)
+
+        assert s.sweep_.shape == (len(thresholds), 7)
+
+        for i, threshold in enumerate(thresholds):
+            r = CTRWfractal(
+                grid_size=self.grid_size,
+                lattice_type=lattice_type,
+                threshold=threshold,
+                random_seed=self.seed,
+            ).run()
+            occupied = r.clusters_[r.clusters_ > r.clusters_.min()]
+
+            assert s.sweep_["OccupiedSites"][i] == occupied.size
+            assert s.sweep_["LargestCluster"][i] == -occupied.min()
+
+
+class TestOutOfCore:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 64
+
+    @pytest.mark.parametrize("threshold", [0.3, 0.592746, 0.9])
+    def test_cluster_sizes(self, threshold):
+        s = CTRWfractal(
+            grid_size=self.grid_size, threshold=threshold, random_seed=self.seed,
+        ).run_out_of_core()
+
+        assert isinstance(s.cluster_sizes_, pd.DataFrame)
+        assert np.all(np.diff(s.cluster_sizes_["Size"]) > 0)
+        assert np.all(s.cluster_sizes_["Count"] > 0)
+
+        # Every occupied site belongs to exactly one cluster
+        n_occupied = np.sum(s.cluster_sizes_["Size"] * s.cluster_sizes_["Count"])
+        assert n_occupied == round(s.occupied_fraction_ * self.grid_size ** 2)
+        assert abs(s.occupied_fraction_ - threshold) < 0.05
+
+    def test_full_lattice(self):
+        s = CTRWfractal(
+            grid_size=self.grid_size, threshold=1.0, random_seed=self.seed,
+        ).run_out_of_core()
+
+        assert s.cluster_sizes_.shape == (1, 2)
+        assert s.cluster_sizes_["Size"][0] == self.grid_size ** 2
+        assert s.cluster_sizes_["Count"][0] == 1
+
+    @pytest.mark.parametrize("threshold", [0.3, 0.592746, 0.9])
+    def test_matches_run(self, threshold):
+        # Same occupation as Bernoulli occupation in memory
+        s = CTRWfractal(
+            grid_size=self.grid_size, threshold=threshold, random_seed=self.seed,
+        ).run_out_of_core()
+        t = CTRWfractal(
+            grid_size=self.grid_size,
+            threshold=threshold,
+            random_seed=self.seed,
+            occupancy="bernoulli",
+        ).run()
+
+        sizes, counts = np.unique(t.label_sizes_, return_counts=True)
+        np.testing.assert_array_equal(s.cluster_sizes_["Size"], sizes)
+        np.testing.assert_array_equal(s.cluster_sizes_["Count"], counts)
+
+
+class TestAdvance:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 32
+
+    @pytest.mark.parametrize(
+        "lattice_type, percolation_type, labelling",
+        [
+            ("square", "site", "sequential"),
+            ("honeycomb", "site", "sequential"),
+            ("square", "bond", "sequential"),
+            ("honeycomb", "site", "parallel"),
+        ],
+    )
+    def test_advance_matches_run(self, lattice_type, percolation_type, labelling):
+        kwargs = dict(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            random_seed=self.seed,
+            labelling=labelling,
+            percolation_type=percolation_type,
+        )
+        s = CTRWfractal(threshold=0.55, **kwargs).percolate()
+
+        for threshold in [0.55, 0.6, 0.65]:
+            if threshold > 0.55:
+                s.advance(threshold)
+
+            r = CTRWfractal(threshold=threshold, **kwargs).run()
+            np.testing.assert_array_equal(s.clusters_, r.clusters_)
+            np.testing.assert_array_equal(s.lattice_, r.lattice_)
+            assert s.occupied_fraction_ == r.occupied_fraction_
+            if labelling == "sequential":
+                np.testing.assert_array_equal(s.wrapping_, r.wrapping_)
+            else:
+                assert s.wrapping_ is None
+
+
+class TestLabels:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 32
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    @pytest.mark.parametrize("percolation_type", ["site", "bond"])
+    def test_labels(self, lattice_type, percolation_type):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=0.5,
+            random_seed=self.seed,
+            percolation_type=percolation_type,
+        ).run()
+
+        occupied = s.clusters_ >= -s.clusters_.size
+        np.testing.assert_array_equal(s.labels_ >= 0, occupied)
+        np.testing.assert_array_equal(s.label_sizes_[s.labels_[occupied]], -s.clusters_[occupied])
+        np.testing.assert_array_equal(np.bincount(s.labels_[occupied]), s.label_sizes_)
+        assert np.all(np.diff(s.label_sizes_) <= 0)
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_labels_match_parallel(self, lattice_type):
+        s1 = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            random_seed=self.seed,
+            site_order="morton",
+            labelling="parallel",
+        ).run()
+        s2 = CTRWfractal(
+            grid_size=self.grid_size, lattice_type=lattice_type, random_seed=self.seed,
+        ).run()
+
+        np.testing.assert_array_equal(s1.labels_, s2.labels_)
+        np.testing.assert_array_equal(s1.label_sizes_, s2.label_sizes_)
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_cluster_sites(self, lattice_type):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=0.55,
+            random_seed=self.seed,
+        ).percolate()
+        s.advance(0.6)
+
+        for label in [0, 1, s.label_sizes_.size - 1]:
+            np.testing.assert_array_equal(
+                s.cluster_sites(label), np.flatnonzero(s.labels_ == label)
+            )
+        assert s.cluster_sites(s.label_sizes_.size).size == 0
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_largest_walks_start_on_largest(self, lattice_type):
+        kwargs = dict(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=0.7,
+            random_seed=self.seed,
+        )
+        s = CTRWfractal(walk_type="largest", n_walks=20, n_steps=5, **kwargs).run()
+        r = CTRWfractal(**kwargs).run()
+
+        # Walks start in the home unit cell
+        largest = r.lattice_[r.labels_ == 0]
+        for start in s.walks_[:, 0, :]:
+            assert np.any(np.all(np.isclose(largest, start), axis=1))
+
+
+class TestStatistics:
+    def setup_method(self, method):
+        self.seed = 123
+        self.grid_size = 32
+
+    @pytest.mark.parametrize(
+        "lattice_type, percolation_type, labelling",
+        [
+            ("square", "site", "sequential"),
+            ("honeycomb", "site", "sequential"),
+            ("square", "bond", "sequential"),
+            ("honeycomb", "site", "parallel"),
+        ],
+    )
+    def test_statistics_match_clusters(self, lattice_type, percolation_type, labelling):
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=0.45,
+            random_seed=self.seed,
+            labelling=labelling,
+            percolation_type=percolation_type,
+        ).run()
+        t = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=0.45,
+            random_seed=self.seed,
+            labelling=labelling,
+            percolation_type=percolation_type,
+        ).cluster_statistics()
+
+        # Every site of a cluster of size s is labelled -s
+        occupied = -s.clusters_[s.clusters_ >= -s.clusters_.size]
+        sizes, counts = np.unique(occupied, return_counts=True)
+        np.testing.assert_array_equal(t.cluster_sizes_["Size"], sizes)
+        np.testing.assert_array_equal(t.cluster_sizes_["Count"], counts // sizes)
+        assert t.largest_cluster_ == sizes.max()
+
+        radii = t.cluster_radii_
+        assert radii.shape[0] == t.cluster_sizes_["Count"].sum()
+        assert np.all(radii["RadiusOfGyration"] >= 0.0)
+        assert np.all(radii["RadiusOfGyration"][radii["Size"] == 1] == 0.0)
+
+    @pytest.mark.parametrize("lattice_type", ["square", "honeycomb"])
+    def test_radius_of_gyration(self, lattice_type):
+        # Both lattices have unit bond length, so every pair of sites
+        # has a radius of gyration of 1/2
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            lattice_type=lattice_type,
+            threshold=0.3,
+            random_seed=self.seed,
+        ).cluster_statistics()
+
+        radii = s.cluster_radii_
+        assert np.any(radii["Size"] == 2)
+        np.testing.assert_allclose(radii["RadiusOfGyration"][radii["Size"] == 2], 0.5)
+        assert np.all(radii["RadiusOfGyration"][radii["Size"] > 2] > 0.5)
+
+    def test_statistics_after_advance(self):
+        s = CTRWfractal(
+            grid_size=self.grid_size, threshold=0.5, random_seed=self.seed
+        ).percolate()
+        s.advance(0.6).cluster_statistics()
+        t = CTRWfractal(
+            grid_size=self.grid_size, threshold=0.6, random_seed=self.seed
+        ).cluster_statistics()
+
+        pd.testing.assert_frame_equal(s.cluster_sizes_, t.cluster_sizes_)
+        pd.testing.assert_frame_equal(s.cluster_radii_, t.cluster_radii_)
+
+    def test_statistics_after_parallel_advance(self):
+        # Below the threshold, no cluster wraps, so the radii do not
+        # depend on the labelling
+        s = CTRWfractal(
+            grid_size=self.grid_size,
+            threshold=0.3,
+            random_seed=self.seed,
+            labelling="parallel",
+        ).percolate()
+        s.advance(0.4).cluster_statistics()
+        t = CTRWfractal(
+            grid_size=self.grid_size, threshold=0.4, random_seed=self.seed
+        ).cluster_statistics()
+
+        pd.testing.assert_frame_equal(s.cluster_sizes_, t.cluster_sizes_)
+        pd.testing.assert_frame_equal(s.cluster_radii_, t.cluster_radii_)
+
+
 class TestErrors:
     def setup_method(self, method):
         self.seed = 123
@@ -184,11 +728,77 @@ class TestErrors:
         with pytest.raises(ValueError, match="Invalid walk_type parameter"):
             s.run()
 
+    def test_out_of_core_lattice_error(self):
+        s = CTRWfractal(grid_size=self.grid_size, lattice_type="honeycomb")
+        with pytest.raises(ValueError, match="only supports 'square'"):
+            s.run_out_of_core()
+
+    def test_percolation_type_error(self):
+        s = CTRWfractal(grid_size=self.grid_size, percolation_type="continuum")
+        with pytest.raises(ValueError, match="Invalid percolation_type parameter"):
+            s.run()
+
+    def test_labelling_error(self):
+        s = CTRWfractal(grid_size=self.grid_size, labelling="random")
+        with pytest.raises(ValueError, match="Invalid labelling parameter"):
+            s.run()
+
+    def test_occupancy_error(self):
+        s = CTRWfractal(grid_size=self.grid_size, occupancy="poisson")
+        with pytest.raises(ValueError, match="Invalid occupancy parameter"):
+            s.run()
+
+        s = CTRWfractal(
+            grid_size=self.grid_size, percolation_type="bond", occupancy="bernoulli"
+        )
+        with pytest.raises(ValueError, match="only supports 'site'"):
+            s.run()
+
+        s = CTRWfractal(grid_size=self.grid_size, occupancy="bernoulli")
+        with pytest.raises(ValueError, match="sweep only supports 'fixed'"):
+            s.sweep([0.5])
+
+        s.percolate()
+        with pytest.raises(ValueError, match="advance only supports 'fixed'"):
+            s.advance(0.7)
+
+    def test_site_order_error(self):
+        s = CTRWfractal(grid_size=self.grid_size, site_order="hilbert")
+        with pytest.raises(ValueError, match="Invalid site_order parameter"):
+            s.run()
+
+        s = CTRWfractal(grid_size=48, site_order="morton")
+        with pytest.raises(ValueError, match="power of 2"):
+            s.run()
+
     def test_threshold_error(self):
         s = CTRWfractal(grid_size=self.grid_size, threshold=-0.2)
         with pytest.raises(ValueError, match="Invalid threshold parameter"):
             s.run()
 
+    def test_sweep_thresholds_error(self):
+        s = CTRWfractal(grid_size=self.grid_size)
+        with pytest.raises(ValueError, match="Invalid thresholds parameter"):
+            s.sweep([0.5, 1.2])
+
+    def test_advance_error(self):
+        s = CTRWfractal(grid_size=self.grid_size, threshold=0.6)
+        with pytest.raises(ValueError, match="percolate must be called"):
+            s.advance(0.7)
+
+        s.percolate()
+        with pytest.raises(ValueError, match="Invalid threshold parameter"):
+            s.advance(0.5)
+
+    def test_cluster_sites_error(self):
+        s = CTRWfractal(grid_size=self.grid_size)
+        with pytest.raises(ValueError, match="percolate must be called"):
+            s.cluster_sites(0)
+
+        s.percolate()
+        with pytest.raises(ValueError, match="Invalid label parameter"):
+            s.cluster_sites(-1)
+
     def test_beta_error(self):
         s = CTRWfractal(grid_size=self.grid_size, beta=-0.2)
         with pytest.raises(ValueError, match="Invalid beta parameter"):
@@ -203,3 +813,8 @@ class TestErrors:
         s = CTRWfractal(grid_size=self.grid_size, noise=-0.2)
         with pytest.raises(ValueError, match="Invalid noise parameter"):
             s.run()
+
+    def test_empty_lattice_walks_error(self):
+        s = CTRWfractal(grid_size=self.grid_size, threshold=0.0, n_walks=2, n_steps=10)
+        with pytest.raises(ValueError, match="No occupied sites"):
+            s.run()
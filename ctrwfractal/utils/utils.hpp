@@ -77,6 +77,53 @@ inline double TAMSD(const arma::mat &walk, const uint64_t t, const uint64_t delt
     return integral / diff;
 };
 
+inline uint64_t MortonSpread(uint64_t x)
+{
+    // Spread the lower 32 bits of x to the even bits of the result
+    x &= 0x00000000FFFFFFFF;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0F;
+    x = (x | (x << 2)) & 0x3333333333333333;
+    x = (x | (x << 1)) & 0x5555555555555555;
+    return x;
+}
+
+inline uint64_t MortonCompact(uint64_t x)
+{
+    // Inverse of MortonSpread: gather the even bits of x
+    x &= 0x5555555555555555;
+    x = (x | (x >> 1)) & 0x3333333333333333;
+    x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0F;
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FF;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFF;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFF;
+    return x;
+}
+
+template <typename RNG>
+inline uint64_t BoundedRand(RNG &rng, const uint64_t range)
+{
+    // Unbiased integer in [0, range), range > 0, by multiply and reject
+    // (D. Lemire, ACM Trans. Model. Comput. Simul. 29, 3 (2019))
+    uint64_t x = rng();
+    __uint128_t m = static_cast<__uint128_t>(x) * range;
+    uint64_t low = static_cast<uint64_t>(m);
+
+    if (low < range)
+    {
+        const uint64_t floor = -range % range; // (2^64 - range) % range
+        while (low < floor)
+        {
+            x = rng();
+            m = static_cast<__uint128_t>(x) * range;
+            low = static_cast<uint64_t>(m);
+        }
+    }
+
+    return static_cast<uint64_t>(m >> 64);
+}
+
 template <typename Function, typename Integer_Type>
 void parallel(Function const &func,
               Integer_Type dimFirst,
@@ -15,11 +15,28 @@
 # You should have received a copy of the GNU General Public License
 # along with ctrwfractal.  If not, see <http://www.gnu.org/licenses/>.
 
+import os
+
 import numpy as np
 from Cython.Build import cythonize
 from setuptools import find_packages, setup
 from setuptools.extension import Extension
 
+# Optional compile-time switches, e.g. CTRW_IMPLICIT_NEIGHBOURS=1 pip install -e .
+#  - CTRW_IMPLICIT_NEIGHBOURS: compute lattice neighbours on the fly
+#    instead of storing the neighbour table
+#  - CTRW_FIND_HALVING, CTRW_FIND_SPLITTING: use path halving or path
+#    splitting in the union-find instead of full path compression
+define_macros = [
+    (macro, None)
+    for macro in [
+        "CTRW_IMPLICIT_NEIGHBOURS",
+        "CTRW_FIND_HALVING",
+        "CTRW_FIND_SPLITTING",
+    ]
+    if os.environ.get(macro, "0") not in ("", "0")
+]
+
 extensions = [
     Extension(
         "ctrwfractal._ctrwfractal",
@@ -27,6 +44,7 @@ extensions = [
         include_dirs=["ctrwfractal/", np.get_include()],
         libraries=["openblas", "lapack", "armadillo"],
         language="c++",
+        define_macros=define_macros,
         extra_compile_args=[
             "-O3",
             "-fPIC",